@@ -0,0 +1,230 @@
+#ifndef HP_ALLOCSTATS_H
+#define HP_ALLOCSTATS_H
+
+#include <iostream>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#ifdef HP_ALLOC_STATS
+#include <sys/resource.h>
+#endif
+
+/* PHASES HEAP ALLOCATIONS ARE CHARGED TO */
+enum Phase : size_t
+{
+  PHASE_OTHER = 0,    //Anything outside a marked phase
+  PHASE_EVALUATION,   //Experiment::Evaluation_step, minus the phases below
+  PHASE_RESET,        //Graph::Reset
+  PHASE_BROADCAST,    //Graph::Broadcast, the BroadcastMail dispatch
+  PHASE_SELECTION,    //Experiment::Selection_step and Enemy_step
+  PHASE_UPDATE,       //Experiment::Update_step
+  PHASE_SNAPSHOT,     //Experiment::Snapshot_step
+  NUM_PHASES
+};
+
+/* CLASS USED TO COUNT HEAP ALLOCATIONS PER PHASE */
+
+//Only counts when built with -DHP_ALLOC_STATS (make alloc-stats), which
+//replaces the global operator new. Otherwise every function here is empty
+//and PhaseScope compiles away.
+//Allocations go to the innermost PhaseScope open on the allocating thread,
+//and to the counters of the owner that scope names (one per Experiment, so
+//sweep rows running side by side do not mix), or the owner of the scope
+//around it. Allocations outside every owner go to Global().
+//Peak RSS is read (getrusage) when an outermost scope closes, so a phase's
+//peak is the largest resident set seen at the end of one of its runs. The
+//resident set is the whole process, whatever the owner.
+class AllocStats
+{
+  public:
+#ifdef HP_ALLOC_STATS
+    static constexpr bool ENABLED = true;
+#else
+    static constexpr bool ENABLED = false;
+#endif
+
+    AllocStats() {;}
+
+    AllocStats(const AllocStats &) = delete;
+    AllocStats & operator=(const AllocStats &) = delete;
+
+    /* FUNCTIONS DEDICATED TO COUNTING */
+
+    //Will charge one allocation of bytes to the current phase of the current owner
+    static void Count(size_t bytes)
+    {
+      Counter & c = CurOwner().mCounters[CurPhase()];
+      c.mAllocs.fetch_add(1, std::memory_order_relaxed);
+      c.mBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    //Will record the resident set size as a peak of phase
+    void MarkPeak(size_t phase);
+
+    //Will charge every allocation counted by other, whatever its phase, to phase
+    void Absorb(const AllocStats & other, size_t phase)
+    {
+      for(size_t p = 0; p < NUM_PHASES; ++p)
+      {
+        mCounters[phase].mAllocs.fetch_add(other.GetAllocs(p), std::memory_order_relaxed);
+        mCounters[phase].mBytes.fetch_add(other.mCounters[p].mBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      }
+    }
+
+    //Phase of the calling thread
+    static size_t & CurPhase()
+    {
+      static thread_local size_t phase = PHASE_OTHER;
+      return phase;
+    }
+
+    //Owner the calling thread charges, null for Global()
+    static AllocStats *& Owner()
+    {
+      static thread_local AllocStats * owner = nullptr;
+      return owner;
+    }
+
+    //Will return the owner the calling thread charges
+    static AllocStats & CurOwner() {return Owner() ? *Owner() : Global();}
+
+    //Counters of allocations made outside every owner
+    static AllocStats & Global()
+    {
+      static AllocStats global;
+      return global;
+    }
+
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return allocations of phase since the last Report
+    size_t GetAllocs(size_t phase) const {return mCounters[phase].mAllocs.load(std::memory_order_relaxed);}
+
+    //Return allocations of evaluating agents (evaluation, reset and broadcast) since the last Report
+    size_t GetEvalAllocs() const {return GetAllocs(PHASE_EVALUATION) + GetAllocs(PHASE_RESET) + GetAllocs(PHASE_BROADCAST);}
+
+
+    /* FUNCTIONS DEDICATED TO PRINTING OUT CRAP */
+
+    //Will print allocations, bytes and peak RSS per phase, then zero the counts
+    void Report(std::ostream & os = std::cout);
+
+  private:
+    struct Counter
+    {
+      std::atomic<size_t> mAllocs{0};
+      std::atomic<size_t> mBytes{0};
+      std::atomic<long> mPeakKB{0};
+    };
+
+    Counter mCounters[NUM_PHASES];
+};
+
+/* CLASS USED TO MARK A PHASE FOR ITS LIFETIME */
+
+//A null owner keeps the owner of the calling thread, so scopes inside
+//Graph charge whichever Experiment is running it
+class PhaseScope
+{
+  public:
+#ifdef HP_ALLOC_STATS
+    PhaseScope(size_t phase, AllocStats * owner = nullptr) :
+    mPrev(AllocStats::CurPhase()), mPhase(phase), mPrevOwner(AllocStats::Owner())
+    {
+      AllocStats::CurPhase() = phase;
+      if(owner)
+        AllocStats::Owner() = owner;
+    }
+
+    ~PhaseScope()
+    {
+      if(mPrev == PHASE_OTHER)
+        AllocStats::CurOwner().MarkPeak(mPhase);
+      AllocStats::CurPhase() = mPrev;
+      AllocStats::Owner() = mPrevOwner;
+    }
+
+  private:
+    size_t mPrev;
+    size_t mPhase;
+    AllocStats * mPrevOwner;
+#else
+    PhaseScope(size_t, AllocStats * = nullptr) {;}
+#endif
+};
+
+/* FUNCTIONS DEDICATED TO COUNTING */
+
+//Will record the resident set size as a peak of phase
+void AllocStats::MarkPeak(size_t phase)
+{
+#ifdef HP_ALLOC_STATS
+  struct rusage use;
+  if(getrusage(RUSAGE_SELF, &use) != 0)
+    return;
+
+  std::atomic<long> & peak = mCounters[phase].mPeakKB;
+  long cur = peak.load(std::memory_order_relaxed);
+  while(use.ru_maxrss > cur && !peak.compare_exchange_weak(cur, use.ru_maxrss, std::memory_order_relaxed))
+  {;}
+#else
+  (void) phase;
+#endif
+}
+
+/* FUNCTIONS DEDICATED TO PRINTING OUT CRAP */
+
+//Will print allocations, bytes and peak RSS per phase, then zero the counts
+//As "phase allocs/bytesB@peakKB", peaks are kept since RSS only grows
+void AllocStats::Report(std::ostream & os)
+{
+  if(!ENABLED)
+    return;
+
+  static const char * names[NUM_PHASES] = {"other", "evaluation", "reset", "broadcast", "selection", "update", "snapshot"};
+
+  os << " ALLOCS:";
+  for(size_t p = 0; p < NUM_PHASES; ++p)
+  {
+    Counter & c = mCounters[p];
+    os << " " << names[p] << " " << c.mAllocs.exchange(0, std::memory_order_relaxed)
+       << "/" << c.mBytes.exchange(0, std::memory_order_relaxed) << "B";
+
+    long peak = c.mPeakKB.load(std::memory_order_relaxed);
+    if(peak)
+      os << "@" << peak << "KB";
+  }
+  os << std::endl;
+}
+
+#ifdef HP_ALLOC_STATS
+
+/* GLOBAL ALLOCATION HOOKS, ONLY IN AN HP_ALLOC_STATS BUILD */
+
+void * operator new(size_t bytes)
+{
+  AllocStats::Count(bytes);
+  if(void * p = std::malloc(bytes ? bytes : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void * operator new[](size_t bytes)
+{
+  AllocStats::Count(bytes);
+  if(void * p = std::malloc(bytes ? bytes : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept {std::free(p);}
+void operator delete[](void * p) noexcept {std::free(p);}
+void operator delete(void * p, size_t) noexcept {std::free(p);}
+void operator delete[](void * p, size_t) noexcept {std::free(p);}
+
+#endif
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef HP_ARCHIVE_H
+#define HP_ARCHIVE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+
+#include "PackedGenome.h"
+
+/* STRUCT HOLDING ONE ARCHIVED GENOME */
+struct Elite
+{
+  //Score the genome got in its generation
+  double mScore = 0;
+  //The genome itself
+  PackedGenome mGenome;
+};
+
+/* CLASS USED TO WRITE ELITES TO DISK FROM A BACKGROUND THREAD */
+
+//Two files are written:
+//  <name>.hpa  "HPA1", then one chunk per snapshot:
+//              [gen u64][raw bytes u32][packed bytes u32][packed chunk]
+//  <name>.hpi  one [gen u64][offset of chunk in .hpa u64] entry per snapshot
+//A raw chunk is [elites u32] then [score f64][genome bytes u32][genome] per
+//elite, best first, and is run length coded (PackBits) before writing.
+//The index only grows in generation order, so Read() can binary search it.
+class Archive
+{
+  public:
+    Archive(const std::string & name, size_t queue) :
+    mName(name), mQueueMax(queue ? queue : 1)
+    {;}
+
+    ~Archive() {Close();}
+
+    /* FUNCTIONS DEDICATED TO WRITING */
+
+    //Will create (or truncate) the archive and start the writer thread
+    bool Open();
+
+    //Will hand the elites of generation gen to the writer thread
+    //Only blocks when the writer is mQueueMax snapshots behind
+    void Push(size_t gen, std::vector<Elite> && elites);
+
+    //Will write everything still queued and stop the writer thread
+    void Close();
+
+    //Return snapshots waiting for the writer thread
+    size_t GetQueued()
+    {
+      std::unique_lock<std::mutex> lock(mLock);
+      return mQueue.size();
+    }
+
+
+    /* FUNCTIONS DEDICATED TO READING */
+
+    //Will load the last snapshot taken at or before gen, gen is set to its generation
+    static bool Read(const std::string & name, size_t & gen, std::vector<Elite> & elites);
+
+
+    /* FUNCTIONS DEDICATED TO RUN LENGTH CODING */
+
+    //Will append the PackBits coding of in to out
+    static void Compress(const std::vector<uint8_t> & in, std::vector<uint8_t> & out);
+
+    //Will append the decoding of n coded bytes to out, false if they are corrupt
+    static bool Expand(const uint8_t * in, size_t n, std::vector<uint8_t> & out);
+
+  private:
+    //One snapshot waiting to be written
+    struct Chunk
+    {
+      size_t mGen;
+      std::vector<Elite> mElites;
+    };
+
+    //Loop run by the writer thread
+    void Work();
+
+    //Will append one chunk to the data and index files
+    void WriteChunk(const Chunk & chunk);
+
+    template<typename T>
+    static void Put(std::vector<uint8_t> & buf, T v)
+    {
+      size_t off = buf.size();
+      buf.resize(off + sizeof(T));
+      std::memcpy(&buf[off], &v, sizeof(T));
+    }
+
+    template<typename T>
+    static bool Get(const std::vector<uint8_t> & buf, size_t & off, T & v)
+    {
+      if(off + sizeof(T) > buf.size())
+        return false;
+      std::memcpy(&v, &buf[off], sizeof(T));
+      off += sizeof(T);
+      return true;
+    }
+
+    //Base name of the files
+    std::string mName;
+    //Data and index files
+    std::ofstream mData;
+    std::ofstream mIndex;
+    //Snapshots waiting for the writer
+    std::deque<Chunk> mQueue;
+    //Most snapshots allowed to wait
+    size_t mQueueMax;
+    //Guards mQueue and mStop
+    std::mutex mLock;
+    std::condition_variable mNotEmpty;
+    std::condition_variable mNotFull;
+    //Set when no more snapshots will come
+    bool mStop = false;
+    //Writer thread
+    std::thread mThread;
+    //Reused coding buffers, only touched by the writer thread
+    std::vector<uint8_t> mRaw;
+    std::vector<uint8_t> mPacked;
+};
+
+/* FUNCTIONS DEDICATED TO WRITING */
+
+//Will create (or truncate) the archive and start the writer thread
+bool Archive::Open()
+{
+  Archive::Close();
+
+  mData.open(mName + ".hpa", std::ios::binary | std::ios::trunc);
+  mIndex.open(mName + ".hpi", std::ios::binary | std::ios::trunc);
+
+  if(!mData.is_open() || !mIndex.is_open())
+  {
+    std::cout << "Failed to open archive files(" << mName << ".hpa/.hpi)." << std::endl;
+    return false;
+  }
+
+  mData.write("HPA1", 4);
+  mStop = false;
+  mThread = std::thread([this]() {this->Work();});
+
+  return true;
+}
+
+//Will hand the elites of generation gen to the writer thread
+void Archive::Push(size_t gen, std::vector<Elite> && elites)
+{
+  if(!mThread.joinable())
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock(mLock);
+    mNotFull.wait(lock, [this]() {return mQueue.size() < mQueueMax;});
+    mQueue.push_back(Chunk{gen, std::move(elites)});
+  }
+
+  mNotEmpty.notify_one();
+}
+
+//Will write everything still queued and stop the writer thread
+void Archive::Close()
+{
+  if(!mThread.joinable())
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock(mLock);
+    mStop = true;
+  }
+
+  mNotEmpty.notify_one();
+  mThread.join();
+  mData.close();
+  mIndex.close();
+}
+
+//Loop run by the writer thread
+void Archive::Work()
+{
+  while(true)
+  {
+    Chunk chunk;
+
+    {
+      std::unique_lock<std::mutex> lock(mLock);
+      mNotEmpty.wait(lock, [this]() {return mStop || !mQueue.empty();});
+
+      if(mQueue.empty())
+        return;
+
+      chunk = std::move(mQueue.front());
+      mQueue.pop_front();
+    }
+
+    mNotFull.notify_one();
+    Archive::WriteChunk(chunk);
+  }
+}
+
+//Will append one chunk to the data and index files
+void Archive::WriteChunk(const Chunk & chunk)
+{
+  mRaw.clear();
+  Put<uint32_t>(mRaw, chunk.mElites.size());
+  for(const Elite & e : chunk.mElites)
+  {
+    const std::vector<uint8_t> & data = e.mGenome.GetData();
+    Put<double>(mRaw, e.mScore);
+    Put<uint32_t>(mRaw, data.size());
+    mRaw.insert(mRaw.end(), data.begin(), data.end());
+  }
+
+  mPacked.clear();
+  Archive::Compress(mRaw, mPacked);
+
+  std::vector<uint8_t> head;
+  Put<uint64_t>(head, chunk.mGen);
+  Put<uint32_t>(head, mRaw.size());
+  Put<uint32_t>(head, mPacked.size());
+
+  uint64_t offset = mData.tellp();
+  mData.write((const char *) head.data(), head.size());
+  mData.write((const char *) mPacked.data(), mPacked.size());
+  mData.flush();
+
+  //Index entry goes last so a reader never sees a half written chunk
+  head.clear();
+  Put<uint64_t>(head, chunk.mGen);
+  Put<uint64_t>(head, offset);
+  mIndex.write((const char *) head.data(), head.size());
+  mIndex.flush();
+}
+
+/* FUNCTIONS DEDICATED TO READING */
+
+//Will load the last snapshot taken at or before gen, gen is set to its generation
+bool Archive::Read(const std::string & name, size_t & gen, std::vector<Elite> & elites)
+{
+  std::ifstream index(name + ".hpi", std::ios::binary);
+  std::ifstream data(name + ".hpa", std::ios::binary);
+
+  if(!index.is_open() || !data.is_open())
+  {
+    std::cout << "Failed to open archive files(" << name << ".hpa/.hpi)." << std::endl;
+    return false;
+  }
+
+  auto entry = [&index](size_t i, uint64_t & g, uint64_t & off)
+  {
+    index.seekg(i * 16);
+    index.read((char *) &g, sizeof(g));
+    index.read((char *) &off, sizeof(off));
+  };
+
+  index.seekg(0, std::ios::end);
+  size_t lo = 0, hi = (size_t) index.tellg() / 16;
+  uint64_t g = 0, off = 0;
+
+  //Find the first entry past gen
+  while(lo < hi)
+  {
+    size_t mid = (lo + hi) / 2;
+    entry(mid, g, off);
+
+    if(g <= gen)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if(lo == 0)
+    return false;
+
+  entry(lo - 1, g, off);
+
+  std::vector<uint8_t> head(16);
+  data.seekg(off);
+  data.read((char *) head.data(), head.size());
+
+  size_t at = 0;
+  uint64_t chunk_gen;
+  uint32_t raw_size, packed_size;
+  Get(head, at, chunk_gen);
+  Get(head, at, raw_size);
+  Get(head, at, packed_size);
+
+  std::vector<uint8_t> packed(packed_size), raw;
+  data.read((char *) packed.data(), packed.size());
+
+  if(!data || chunk_gen != g || !Archive::Expand(packed.data(), packed.size(), raw) || raw.size() != raw_size)
+  {
+    std::cout << "Archive chunk for generation " << g << " is corrupt." << std::endl;
+    return false;
+  }
+
+  at = 0;
+  uint32_t count;
+  Get(raw, at, count);
+  elites.resize(count);
+
+  for(Elite & e : elites)
+  {
+    uint32_t bytes;
+    if(!Get(raw, at, e.mScore) || !Get(raw, at, bytes) || at + bytes > raw.size())
+      return false;
+
+    e.mGenome.SetData(raw.data() + at, bytes);
+    at += bytes;
+  }
+
+  gen = g;
+  return true;
+}
+
+/* FUNCTIONS DEDICATED TO RUN LENGTH CODING */
+
+//Will append the PackBits coding of in to out
+//Header h < 128: copy the next h + 1 bytes, h > 128: repeat the next byte 257 - h times
+void Archive::Compress(const std::vector<uint8_t> & in, std::vector<uint8_t> & out)
+{
+  size_t i = 0, n = in.size();
+
+  while(i < n)
+  {
+    size_t run = 1;
+    while(i + run < n && run < 128 && in[i + run] == in[i])
+      ++run;
+
+    if(run >= 3)
+    {
+      out.push_back(257 - run);
+      out.push_back(in[i]);
+      i += run;
+      continue;
+    }
+
+    //Copy literally until the next run of three
+    size_t start = i;
+    while(i < n && i - start < 128)
+    {
+      if(i + 2 < n && in[i] == in[i + 1] && in[i] == in[i + 2])
+        break;
+      ++i;
+    }
+
+    out.push_back(i - start - 1);
+    out.insert(out.end(), in.begin() + start, in.begin() + i);
+  }
+}
+
+//Will append the decoding of n coded bytes to out, false if they are corrupt
+bool Archive::Expand(const uint8_t * in, size_t n, std::vector<uint8_t> & out)
+{
+  size_t i = 0;
+
+  while(i < n)
+  {
+    uint8_t h = in[i++];
+
+    if(h < 128)
+    {
+      size_t len = h + 1;
+      if(i + len > n)
+        return false;
+
+      out.insert(out.end(), in + i, in + i + len);
+      i += len;
+    }
+
+    else if(h > 128)
+    {
+      if(i >= n)
+        return false;
+
+      out.insert(out.end(), (size_t) 257 - h, in[i++]);
+    }
+  }
+
+  return true;
+}
+
+#endif
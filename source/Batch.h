@@ -0,0 +1,330 @@
+#ifndef HP_BATCH_H
+#define HP_BATCH_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "hp_config.h"
+#include "Graph.h"
+#include "Library.h"
+#include "Archive.h"
+#include "Experiment.h"
+#include "ThreadPool.h"
+#include "PerfCounter.h"
+#include "Parse.h"
+
+/* CLASS USED TO SCORE FIXED GENOMES WITHOUT EVOLVING THEM */
+
+//Every genome is a program text file (as genome.txt), or <archive>@<gen> for
+//every elite of the last snapshot at or before gen in an archive. Each one is
+//run BATCH_TRIALS times on every GRA_DIM in BATCH_DIMS, GRA_TYPE in
+//BATCH_TYPES and NODE_ORDER in BATCH_ORDERS. Trial t draws its UIDs and schedule from stream (0, 0, t), so
+//every genome faces the same trials and two runs of a batch match exactly.
+//Threads share the trials of one (dim, type) cell, each with its own graph.
+//One CSV line is printed per genome and cell, scores as with Experiment::Adjust.
+//Node orders give the same scores, so comparing them on one genome is a
+//benchmark of the layout: ms_per_eval, the cache misses of the evaluating
+//threads when the kernel allows perf counters (empty otherwise), and
+//near_neighbors, the share of neighbor pairs at most NEAR_WINDOW nodes apart
+//in memory, which needs no counter. The only edge sets are the torus and
+//Moore grids, so compare orders on both with BATCH_TYPES 0,1.
+class Batch
+{
+  public:
+    Batch(const HPConfig & config, size_t threads) :
+    mConfig(config), mThreads(std::max<size_t>(1, threads)),
+    BATCH_TRIALS(std::max<size_t>(1, config.BATCH_TRIALS()))
+    {
+      mLib = emp::NewPtr<Library>(config);
+    }
+
+    ~Batch()
+    {
+      mLib.Delete();
+    }
+
+    /* FUNCTIONS DEDICATED TO EVALUATING */
+
+    //Will load every genome in specs, false if one could not be loaded
+    bool Load(const std::vector<std::string> & specs);
+
+    //Will score every genome on every cell and print the table to os
+    bool Run(std::ostream & os = std::cout);
+
+  private:
+    //Score of every trial of one genome on one cell
+    struct Cell
+    {
+      std::vector<double> mScores;
+      size_t mOverruns = 0;
+      double mSeconds = 0.0;
+      //Cache misses, if every thread could count them
+      uint64_t mMisses = 0;
+      bool mCounted = false;
+      //Share of neighbor pairs at most NEAR_WINDOW nodes apart, see Graph::GetNearNeighbors
+      double mNear = 0.0;
+    };
+
+    //Will read a comma separated list of numbers, fallback if empty
+    static bool ReadList(const std::string & list, size_t fallback, std::vector<size_t> & out);
+
+    //Will run every genome and trial on a dim x dim graph of type, nodes laid out in order
+    void RunCell(size_t dim, size_t type, size_t order, std::vector<Cell> & cells);
+
+    //Nodes apart in memory that still count as near for near_neighbors
+    static constexpr size_t NEAR_WINDOW = 8;
+
+    //Config every graph is built from
+    const HPConfig & mConfig;
+    //Number of evaluation threads
+    size_t mThreads;
+    //Trials per genome and cell
+    size_t BATCH_TRIALS;
+    //Name and genome of everything loaded
+    std::vector<std::string> mNames;
+    std::vector<PackedGenome> mGenomes;
+    //Libraries shared by every graph
+    emp::Ptr<Library> mLib;
+};
+
+/* FUNCTIONS DEDICATED TO EVALUATING */
+
+//Will load every genome in specs, false if one could not be loaded
+bool Batch::Load(const std::vector<std::string> & specs)
+{
+  for(const std::string & spec : specs)
+  {
+    size_t at = spec.rfind('@');
+
+    //Elites of an archived snapshot
+    if(at != std::string::npos)
+    {
+      size_t gen;
+      if(!ReadNumber(spec.substr(at + 1), gen))
+      {
+        std::cout << "Generation " << spec.substr(at + 1) << " in " << spec << " is not a number." << std::endl;
+        return false;
+      }
+
+      std::vector<Elite> elites;
+
+      if(!Archive::Read(spec.substr(0, at), gen, elites) || elites.empty())
+      {
+        std::cout << "No snapshot at or before generation " << spec.substr(at + 1) << " in " << spec.substr(0, at) << "." << std::endl;
+        return false;
+      }
+
+      for(size_t k = 0; k < elites.size(); ++k)
+      {
+        mNames.push_back(spec.substr(0, at) + "@" + std::to_string(gen) + "#" + std::to_string(k));
+        mGenomes.push_back(elites[k].mGenome);
+      }
+
+      continue;
+    }
+
+    std::ifstream in(spec);
+    if(!in.is_open())
+    {
+      std::cout << "Failed to open genome file(" << spec << ")." << std::endl;
+      return false;
+    }
+
+    program_t pro(mLib->GetInstLib());
+    pro.Load(in);
+    mNames.push_back(spec);
+    mGenomes.emplace_back(pro);
+  }
+
+  return !mGenomes.empty();
+}
+
+//Will score every genome on every cell and print the table to os
+//As genome,dim,type,order,trials,min,median,mean,max,sd,overruns,ms_per_eval,misses_per_eval,near_neighbors
+bool Batch::Run(std::ostream & os)
+{
+  std::vector<size_t> dims, types, orders;
+  if(!Batch::ReadList(mConfig.BATCH_DIMS(), mConfig.GRA_DIM(), dims) ||
+     !Batch::ReadList(mConfig.BATCH_TYPES(), mConfig.GRA_TYPE(), types) ||
+     !Batch::ReadList(mConfig.BATCH_ORDERS(), mConfig.NODE_ORDER(), orders))
+  {
+    std::cout << "BATCH_DIMS, BATCH_TYPES and BATCH_ORDERS must be comma separated numbers that fit in size_t." << std::endl;
+    return false;
+  }
+
+  for(size_t order : orders)
+  {
+    if(order >= NUM_ORDERS)
+    {
+      std::cout << "BATCH_ORDERS has unknown node order " << order << "." << std::endl;
+      return false;
+    }
+  }
+
+  for(size_t type : types)
+  {
+    if(type >= NUM_TOPOLOGIES)
+    {
+      std::cout << "BATCH_TYPES has unknown graph type " << type << "." << std::endl;
+      return false;
+    }
+  }
+
+  for(size_t dim : dims)
+  {
+    if(!Graph::CheckUIDs(mConfig, dim, std::cout))
+      return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  os << "genome,dim,type,order,trials,min,median,mean,max,sd,overruns,ms_per_eval,misses_per_eval,near_neighbors" << std::endl;
+
+  for(size_t dim : dims)
+  {
+    for(size_t type : types)
+    {
+      for(size_t order : orders)
+      {
+        std::vector<Cell> cells(mGenomes.size());
+        Batch::RunCell(dim, type, order, cells);
+
+        for(size_t g = 0; g < mGenomes.size(); ++g)
+        {
+          std::vector<double> & scores = cells[g].mScores;
+          std::sort(scores.begin(), scores.end());
+
+          double mean = 0.0, var = 0.0;
+          for(double s : scores)
+            mean += s;
+          mean /= scores.size();
+          for(double s : scores)
+            var += (s - mean) * (s - mean);
+
+          os << mNames[g] << "," << dim << "," << type << "," << order << "," << scores.size() << ","
+             << scores.front() << "," << scores[scores.size() / 2] << "," << mean << ","
+             << scores.back() << "," << std::sqrt(var / scores.size()) << "," << cells[g].mOverruns << ","
+             << 1000.0 * cells[g].mSeconds / scores.size() << ",";
+          if(cells[g].mCounted)
+            os << (double) cells[g].mMisses / scores.size();
+          os << "," << cells[g].mNear << std::endl;
+        }
+      }
+    }
+  }
+
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+  std::cout << "Evaluated " << mGenomes.size() * dims.size() * types.size() * orders.size() * BATCH_TRIALS
+            << " trials in " << wall.count() << "s on " << mThreads << " threads." << std::endl;
+
+  return true;
+}
+
+//Will read a comma separated list of numbers, fallback if empty
+bool Batch::ReadList(const std::string & list, size_t fallback, std::vector<size_t> & out)
+{
+  out.clear();
+  std::stringstream in(list);
+  std::string item;
+
+  while(std::getline(in, item, ','))
+  {
+    if(item.find_first_not_of(" ") == std::string::npos)
+      continue;
+
+    size_t value;
+    if(!ReadNumber(item, value))
+      return false;
+    out.push_back(value);
+  }
+
+  if(out.empty())
+    out.push_back(fallback);
+
+  return true;
+}
+
+//Will run every genome and trial on a dim x dim graph of type, nodes laid out in order
+//Trials are handed out one at a time, so slow genomes do not hold up a thread
+void Batch::RunCell(size_t dim, size_t type, size_t order, std::vector<Cell> & cells)
+{
+  for(Cell & cell : cells)
+    cell.mScores.assign(BATCH_TRIALS, 0.0);
+
+  std::atomic<size_t> next(0);
+  std::vector<std::atomic<size_t>> overruns(cells.size());
+  std::vector<std::atomic<uint64_t>> nanos(cells.size());
+  std::vector<std::atomic<uint64_t>> misses(cells.size());
+  std::atomic<bool> counted(true);
+  double near = 0.0;
+  for(size_t g = 0; g < cells.size(); ++g)
+  {
+    overruns[g] = 0;
+    nanos[g] = 0;
+    misses[g] = 0;
+  }
+
+  size_t total = cells.size() * BATCH_TRIALS;
+  size_t threads = std::min(mThreads, total);
+
+  {
+    ThreadPool pool(threads);
+
+    for(size_t w = 0; w < threads; ++w)
+    {
+      pool.Push([&, w, dim, type, order]()
+      {
+        Graph graph(mConfig, dim);
+        graph.SetOrder(order);
+        graph.CreateGraph(dim, type, mLib->GetInstLib(), mLib->GetEventLib());
+        graph.ConfigureTraits();
+        graph.CreateAdjList(type, dim);
+        program_t pro(mLib->GetInstLib());
+        //Every thread builds the same layout
+        if(w == 0)
+          near = graph.GetNearNeighbors(NEAR_WINDOW);
+        PerfCounter counter;
+        if(!counter.Open())
+          counted = false;
+
+        for(size_t k = next++; k < total; k = next++)
+        {
+          size_t g = k / BATCH_TRIALS, t = k % BATCH_TRIALS;
+          auto begin = std::chrono::steady_clock::now();
+          uint64_t before = counter.Read();
+
+          mGenomes[g].Unpack(pro);
+          graph.SetStream(0, 0, t);
+          graph.Reset();
+          graph.SetGenome(pro);
+          cells[g].mScores[t] = Experiment::Adjust(graph, graph.RunGraph(), mConfig.TRAFFIC_COST());
+
+          if(graph.IsOverrun())
+            ++overruns[g];
+          misses[g] += counter.Read() - before;
+          nanos[g] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        }
+      });
+    }
+
+    pool.Wait();
+  }
+
+  for(size_t g = 0; g < cells.size(); ++g)
+  {
+    cells[g].mOverruns = overruns[g];
+    cells[g].mSeconds = nanos[g] / 1e9;
+    cells[g].mMisses = misses[g];
+    cells[g].mCounted = counted;
+    cells[g].mNear = near;
+  }
+}
+
+#endif
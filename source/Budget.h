@@ -0,0 +1,126 @@
+#ifndef HP_BUDGET_H
+#define HP_BUDGET_H
+
+#include <iostream>
+#include <string>
+
+#include "hp_config.h"
+
+/* STRUCT USED TO CAP THE WORK A SINGLE EVALUATION MAY DO */
+
+//A limit of 0 means no limit.
+//Node limits apply to one node, eval limits to the whole graph, and both
+//are counted from the last Graph::Reset().
+struct Budget
+{
+  //Reasons an evaluation can be stopped
+  enum Reason {NONE = 0, INSTS, CORES, EVENTS, NUM_REASONS};
+
+  Budget(const HPConfig & config) :
+  NODE_INST(config.NODE_INST_BUDGET()), NODE_CORE(config.NODE_CORE_BUDGET()),
+  NODE_EVENT(config.NODE_EVENT_BUDGET()), EVAL_INST(config.EVAL_INST_BUDGET()),
+  EVAL_CORE(config.EVAL_CORE_BUDGET()), EVAL_EVENT(config.EVAL_EVENT_BUDGET()),
+  OVERRUN_SCORE(config.OVERRUN_SCORE())
+  {;}
+
+  /* FUNCTIONS DEDICATED TO SPENDING */
+
+  //Will charge n instructions, false if a limit was passed
+  bool SpendInsts(size_t & node, size_t n) {return Spend(node, mInsts, n, NODE_INST, EVAL_INST, INSTS);}
+
+  //Will charge one spawned core, false if a limit was passed
+  bool SpendCore(size_t & node) {return Spend(node, mCores, 1, NODE_CORE, EVAL_CORE, CORES);}
+
+  //Will charge one queued event, false if a limit was passed
+  bool SpendEvent(size_t & node) {return Spend(node, mEvents, 1, NODE_EVENT, EVAL_EVENT, EVENTS);}
+
+  //Will clear the counters of the current evaluation
+  void Reset()
+  {
+    mInsts = mCores = mEvents = 0;
+    mReason = NONE;
+  }
+
+  //Will return if the current evaluation passed a limit
+  bool IsOverrun() const {return mReason != NONE;}
+
+  //Will return if running instructions alone can pass a limit
+  bool LimitsInsts() const {return NODE_INST || EVAL_INST;}
+
+  //Will return the overruns since the last ClearReport()
+  size_t GetOverruns() const {return mOverruns[INSTS] + mOverruns[CORES] + mOverruns[EVENTS];}
+
+  /* FUNCTIONS DEDICATED TO PRINTING OUT CRAP */
+
+  //Print the overruns since the last ClearReport()
+  void PrintReport(std::ostream & os = std::cout) const
+  {
+    os << " OVERRUNS: " << GetOverruns()
+       << " (inst " << mOverruns[INSTS] << ", core " << mOverruns[CORES]
+       << ", event " << mOverruns[EVENTS] << ")";
+  }
+
+  //Will count an evaluation stopped for why somewhere else, e.g. in a farm worker
+  void AddOverrun(Reason why)
+  {
+    if(why != NONE && why < NUM_REASONS)
+      ++mOverruns[why];
+  }
+
+  //Will add the overrun totals of other to this one
+  void MergeReport(const Budget & other)
+  {
+    for(size_t i = 0; i < NUM_REASONS; ++i)
+      mOverruns[i] += other.mOverruns[i];
+  }
+
+  //Will clear the overrun totals
+  void ClearReport()
+  {
+    for(size_t i = 0; i < NUM_REASONS; ++i)
+      mOverruns[i] = 0;
+  }
+
+  /* LIMITS */
+
+  size_t NODE_INST;
+  size_t NODE_CORE;
+  size_t NODE_EVENT;
+  size_t EVAL_INST;
+  size_t EVAL_CORE;
+  size_t EVAL_EVENT;
+  //Score given to an evaluation that passed a limit
+  double OVERRUN_SCORE;
+
+  /* COUNTERS */
+
+  //Work done in the current evaluation
+  size_t mInsts = 0;
+  size_t mCores = 0;
+  size_t mEvents = 0;
+  //Why the current evaluation was stopped
+  Reason mReason = NONE;
+  //Evaluations stopped per reason since the last ClearReport()
+  size_t mOverruns[NUM_REASONS] = {0};
+
+  private:
+    bool Spend(size_t & node, size_t & eval, size_t n, size_t node_max, size_t eval_max, Reason why)
+    {
+      node += n;
+      eval += n;
+
+      if((node_max && node > node_max) || (eval_max && eval > eval_max))
+      {
+        if(mReason == NONE)
+        {
+          mReason = why;
+          ++mOverruns[why];
+        }
+        return false;
+      }
+
+      return true;
+    }
+};
+
+#endif
@@ -2,19 +2,31 @@
 #define HP_EXPERIMENT_H
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstring>
 
 #include "hp_config.h"
 #include "Graph.h"
+#include "PackedGenome.h"
+#include "Library.h"
+#include "Archive.h"
+#include "Lineage.h"
+#include "ThreadPool.h"
+#include "Farm.h"
+#include "Status.h"
+#include "Mutator.h"
+#include "AllocStats.h"
 #include "../../Empirical/source/tools/Random.h"
 #include "../../Empirical/source/tools/random_utils.h"
 #include "../../Empirical/source/hardware/EventDrivenGP.h"
-#include "../../Empirical/source/Evolve/World.h"
-#include "../../Alex/signalgp-adventures/adventures/utility_belt/source/utilities.h"
 
 /* CONSTEXPR FOR HARDWARE */
 
-//Number of bits in the tag per hardware
-constexpr size_t TAG_WIDTH = 16;
+//Weight of each legal BroadcastVote in the score
 constexpr double VALUE = .0000001;
 
 const std::string NOP_PATH = "genome1.txt";
@@ -23,86 +35,119 @@ const std::string ADVANCE_PATH = "genome2.txt";
 
 /* NEW TYPE DECLARATIONS FOR HARDWARE*/
 
-//Type for a actural hardware
-using hardware_t = emp::EventDrivenGP_AW<TAG_WIDTH>;
-//Type for the hardware genome
-using program_t = hardware_t::Program;
-//Type for the hardwares state 
-using state_t = hardware_t::State;
-//Instruction object for hardware
-using inst_t = hardware_t::inst_t;
-//Instruction library for hardware
-using inst_lib_t = hardware_t::inst_lib_t;
-//Type for Events for each hardware
-using event_t = hardware_t::event_t;
-//Event Libarary for hardware
-using event_lib_t = hardware_t::event_lib_t;
-//Function type for the hardware
-using function_t = hardware_t::Function;
-//Memory type for hardware
-using memory_t = hardware_t::memory_t;
-//Mutator
-using mutant_t = toolbelt::SignalGPMutator<hardware_t>;
-
-/* NEW TYPE DECLARATIONS FOR SIMPLICITY*/
-
-using coor_t = std::pair<size_t, size_t>;
+//Hardware types (hardware_t, program_t, inst_t, ...) come from Graph.h
 
 
 class Experiment
 {
-  struct Agent;
-
-  //World of Agents
-  using world_t = emp::World<Agent>;  
-
   struct Agent
   {
     //Agents score
     double mScore = 0;
 
-    program_t mGenome;
+    //Genome kept packed while resting in the population
+    PackedGenome mGenome;
 
     Agent(const program_t & p) : mGenome(p) {;}
 
-    program_t & GetGenome() {return mGenome;}
+    PackedGenome & GetGenome() {return mGenome;}
   };
 
   public:
-    Experiment(const HPConfig & config) :
+    //lib may be shared with other experiments, otherwise one is built from config
+    Experiment(const HPConfig & config, emp::Ptr<Library> lib = nullptr) :
     POP_SIZE(config.POP_SIZE()), NUM_GENS(config.NUM_GENS()),
     RNG_SEED(config.RNG_SEED()), EVAL_SIZE(config.EVAL_SIZE()),
     TOURN_SIZE(config.TOURN_SIZE()), GRA_DIM(config.GRA_DIM()),
     GRA_TYPE(config.GRA_TYPE()), SNAP_SHOT(config.SNAP_SHOT()),
     NUM_ITER(config.NUM_ITER()), MIN_FUN_CNT(config.MIN_FUN_CNT()),
     MAX_FUN_CNT(config.MAX_FUN_CNT()), MIN_FUN_LEN(config.MIN_FUN_LEN()), 
-    MAX_FUN_LEN(config.MAX_FUN_LEN()), MAX_TOT_LEN(config.MAX_TOT_LEN())    
+    MAX_FUN_LEN(config.MAX_FUN_LEN()), MAX_TOT_LEN(config.MAX_TOT_LEN()),
+    MIN_BIN_THSH(config.MIN_BIN_THSH()), SKIP_INERT(config.SKIP_INERT()), TRAFFIC_COST(config.TRAFFIC_COST()),
+    ARCHIVE_FILE(config.ARCHIVE_FILE()), ARCHIVE_TOP(config.ARCHIVE_TOP()),
+    LINEAGE_FILE(config.LINEAGE_FILE()), TRACE_FILE(config.TRACE_FILE()), STATUS_FILE(config.STATUS_FILE()),
+    SCREEN_DIM(config.SCREEN_DIM()),
+    SCREEN_ITER(config.SCREEN_ITER()), SCREEN_FRAC(config.SCREEN_FRAC()),
+    ADVERSARIAL(config.ADVERSARIAL()), NUM_ENE(config.NUM_ENE()),
+    ENE_POP_SIZE(std::max<size_t>(1, config.ENE_POP_SIZE())), EVAL_THREADS(std::max<size_t>(1, config.EVAL_THREADS())),
+    ALLOC_BUDGET(config.ALLOC_BUDGET())
     {
-      mRng = emp::NewPtr<emp::Random>(RNG_SEED);
-      inst_lib = emp::NewPtr<inst_lib_t>();
-      event_lib = emp::NewPtr<event_lib_t>();
-      mGraph = emp::NewPtr<Graph>(config, mRng);
-      mWorld = emp::NewPtr<world_t>(*mRng, "World");
-      mMutant = emp::NewPtr<mutant_t>(MIN_FUN_CNT, MAX_FUN_CNT, MIN_FUN_LEN, MAX_FUN_LEN, MAX_TOT_LEN);
+      mSelectStream = StreamRandom(RNG_SEED, STREAM_SELECT);
+      mOwnLib = (lib == nullptr);
+      mLib = mOwnLib ? emp::NewPtr<Library>(config) : lib;
+      inst_lib = mLib->GetInstLib();
+      event_lib = mLib->GetEventLib();
+      mProgram = emp::NewPtr<program_t>(inst_lib);
+      mGraph = emp::NewPtr<Graph>(config);
+      if(SCREEN_DIM)
+        mScreen = emp::NewPtr<Graph>(config, SCREEN_DIM, SCREEN_ITER);
+      if(ADVERSARIAL)
+      {
+        for(size_t w = 0; w < EVAL_THREADS; ++w)
+          mWorkers.push_back({emp::NewPtr<Graph>(config), emp::NewPtr<program_t>(inst_lib)});
+        mPool = emp::NewPtr<ThreadPool>(EVAL_THREADS);
+      }
+      REPRO_THREADS = config.REPRO_THREADS() ? config.REPRO_THREADS() : std::max<size_t>(1, std::thread::hardware_concurrency());
+      for(size_t w = 0; w < REPRO_THREADS; ++w)
+        mBreeders.push_back({emp::NewPtr<Mutator>(config, inst_lib->GetSize()), emp::NewPtr<emp::Random>(RNG_SEED),
+                             StreamRandom(RNG_SEED, STREAM_SELECT), StreamRandom(RNG_SEED, STREAM_MUTATE)});
+      mArchive = emp::NewPtr<Archive>(ARCHIVE_FILE, config.ARCHIVE_QUEUE());
+      //Only the plain evaluation runs on the farm, see CheckConfig
+      if(config.FARM_PROCS() && !ADVERSARIAL && !SCREEN_DIM)
+      {
+        //Runs in a worker, on the forked copy of this experiment
+        mFarm = emp::NewPtr<Farm>(config, [this](size_t gen, size_t id, const PackedGenome & genome, Farm::Result & result)
+        {
+          mGen = gen;
+          size_t before = mInertCnt;
+          result.mScore = Experiment::Evaluate(*mGraph, genome, id);
+          result.mInert = (mInertCnt != before);
+          if(!result.mInert)
+          {
+            result.mReason = mGraph->GetBudget().mReason;
+            result.mTraffic = mGraph->GetTraffic();
+          }
+        });
+      }
       THEORY_MAX = NUM_ITER * GRA_DIM * GRA_DIM + 1;
-      SetVote(config.VOTE()); SetUID(config.UID());
-      SetPOSX(config.POSX()); SetPOSY(config.POSY());
+      SCREEN_MAX = SCREEN_ITER * SCREEN_DIM * SCREEN_DIM + 1;
     }
 
     ~Experiment()
     {
+      //Stops the workers first
+      if(mFarm)
+        mFarm.Delete();
       mGraph.Delete();
-      mWorld.Delete();
-      mRng.Delete();
-      mMutant.Delete();
-      inst_lib.Delete();
-      event_lib.Delete();
+      if(mScreen)
+        mScreen.Delete();
+      for(auto & w : mWorkers)
+      {
+        w.mGraph.Delete();
+        w.mProgram.Delete();
+      }
+      if(mPool)
+        mPool.Delete();
+      if(mReproPool)
+        mReproPool.Delete();
+      for(auto & b : mBreeders)
+      {
+        b.mMutant.Delete();
+        b.mRng.Delete();
+      }
+      mProgram.Delete();
+      mArchive.Delete();
+      if(mOwnLib)
+        mLib.Delete();
     }
 
     /* FUNCTIONS DEDICATED TO THE EXPERIMENT */
 
-    //Run the experiment
-    void Run();
+    //Will return if config can run as an experiment, printing why not to os
+    static bool CheckConfig(const HPConfig & config, std::ostream & os = std::cout);
+
+    //Run the experiment, false if it was stopped by ALLOC_BUDGET
+    bool Run();
     
     //Confiugre all the neccesary things
     void Config_All();
@@ -110,12 +155,62 @@ class Experiment
     //Evalute each agent for 
     size_t Evaluation_step();
 
+    //Will screen every agent on mScreen, then promote the best SCREEN_FRAC to mGraph
+    void Screen_step();
+
+    //Will run agent id on graph and return its score
+    double Evaluate(Graph & graph, size_t id, size_t trial = 0);
+
+    //Will run genome as agent id on graph and return its score
+    double Evaluate(Graph & graph, const PackedGenome & genome, size_t id, size_t trial = 0);
+
+    //Will score every agent on the worker processes of mFarm
+    void Farm_step();
+
+    //Will turn a RunGraph score into a fitness: vote bonus and traffic cost, or the overrun score
+    static double Adjust(Graph & graph, double score, double traffic_cost = 0.0);
+
+    //Will add the vote bonus and take the traffic cost of sent mail over nodes from score
+    static double Adjust(double score, double votes, size_t sent, size_t nodes, double traffic_cost);
+
+    //Will play every agent against EVAL_SIZE enemies and fill the score matrix
+    void Adversary_step();
+
+    //Will play agents [begin, end) on worker w
+    void Adversary_batch(size_t w, size_t begin, size_t end);
+
+    //Will select and mutate the enemy population
+    void Enemy_step();
+
     //Selection
     void Selection_step();
 
+    //Will pick the parents of offspring [begin, end) on breeder w
+    void Selection_batch(size_t w, size_t begin, size_t end);
+
     //Update
     void Update_step();
 
+    //Will copy and mutate offspring [begin, end) into mNext on breeder w
+    void Update_batch(size_t w, size_t begin, size_t end);
+
+    //Will run batch(w, begin, end) over contiguous slices of the population, one per breeder
+    template<typename BATCH>
+    void Breed(BATCH batch);
+
+    //Will hand the ARCHIVE_TOP best agents to the archive writer
+    void Snapshot_step();
+
+    //Will publish the metrics of generation gen to STATUS_FILE
+    void Status_step(size_t gen, double elapsed, double gen_secs, double eval_secs);
+
+    //Will print the archived elites of the last snapshot at or before gen
+    bool PrintArchive(size_t gen, std::ostream & os = std::cout);
+
+    //Will mutate the genome of agent in place on breeder w, from mutation stream (mGen, id, trial)
+    //Returns number of mutations
+    size_t Mutate(size_t w, Agent & agent, size_t id, size_t trial = 0);
+
     //Return an genome full of nops
     program_t Genome_NOP();
 
@@ -126,50 +221,25 @@ class Experiment
     program_t Genome_ADVANCE();
 
 
-    /* FUNCTIONS DEDICATED TO THE CONFIGURATIONS, INSTRUCTIONS, EVENTS*/
-
-    //Will make the instruction library
-    void Config_Inst();
+    /* FUNCTIONS DEDICATED TO THE CONFIGURATIONS */
 
-    //Will set the output memory of a hardware to all of its neighboors
-    static void Inst_BroadcastMail(hardware_t & hw, const inst_t & inst);
-
-    //Will send the vote to all of a hardwares neighboors
-    static void Inst_BroadcastVote(hardware_t & hw, const inst_t & inst);
-
-    //Will load the UID of a hardware into its working buffer
-    static void Inst_GetUID(hardware_t & hw, const inst_t & inst);
-    
-    //Will get the vote of a hardware
-    static void Inst_GetVote(hardware_t & hw, const inst_t & inst);
+    //Will fill the population with copies of p
+    void Config_HW(program_t p);
 
-    //Will set the vote of the hardware
-    static void Inst_SetVote(hardware_t & hw, const inst_t & inst);
+    //Will set up the population buffers
+    void Config_World();
 
-    //Will make the event library
-    void Config_Events();
 
-    //Will actually do the event
-    void Dispatch_Broadcast(hardware_t & hw, const event_t & e);
+    /* FUNCTIONS DEDICATED TO SETTERS */
 
-    //Will do the event to send vote out
-    void Dispatch_BroadcastVote(hardware_t & hw, const event_t & e);
+    //Will send the progress lines of Run() to os
+    void SetOutput(std::ostream & os) {mOut = &os;}
 
-    //Will spawn a core for the event
-    static void Handle_Broadcast(hardware_t & hw, const event_t & e);
 
-    //Will create the hardware and add it to the world
-    void Config_HW(program_t p);
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
 
-    //Will configure the world
-    void Config_World();
-
-
-    /* FUNCTIONS DEDICATED TO SETTERS */
-    static void SetVote(size_t x) {VOTE = x;}
-    static void SetUID(size_t x) {UID = x;}
-    static void SetPOSX(size_t x) {POSX = x;}
-    static void SetPOSY(size_t x) {POSY = x;}
+    //Return the best score of every generation run so far
+    const std::vector<double> & GetBestScores() const {return mBestScores;}
 
 
     /* FUNCTIONS DEDICATED TO TEST GRAPH */
@@ -211,37 +281,44 @@ class Experiment
     size_t TOURN_SIZE;
     //Dimension of the graph
     size_t GRA_DIM;
-    //Pointer for random number generator
-    emp::Ptr<emp::Random> mRng;
+    //Stream for the adversary deck and enemy selection, see StreamRandom.h
+    StreamRandom mSelectStream;
+    //Current generation
+    size_t mGen = 0;
     //Pointer for Graph
     emp::Ptr<Graph> mGraph;
+    //Small graph agents are screened on, null when SCREEN_DIM is 0
+    emp::Ptr<Graph> mScreen = nullptr;
     //Graph tyep
     size_t GRA_TYPE;
     //vector to hold positions of hardware
     std::vector<size_t> mHwPos;
-    //World to hold organisms
-    emp::Ptr<world_t> mWorld;
-    //Mutator
-    emp::Ptr<mutant_t> mMutant;
+    //Current population, and the next one being bred
+    std::vector<Agent> mPop;
+    std::vector<Agent> mNext;
+    //Scratch program that packed genomes are expanded into
+    emp::Ptr<program_t> mProgram;
     //Snapshot index
     size_t SNAP_SHOT;
     //All the iterations
     size_t NUM_ITER;
-    //Count of how many time broadcast vote is called
-    double mCount = 0;
     //Theoretical max
     size_t THEORY_MAX;
+    //Where progress lines go
+    std::ostream * mOut = &std::cout;
+    //Best score of every generation
+    std::vector<double> mBestScores;
+    //Background writer for snapshots
+    emp::Ptr<Archive> mArchive;
+    //Ancestry of the population
+    Lineage mLineage;
 
     /* HARDWARE SPECIFIC PARAMATERS */
 
-    //Position of UID within hw trait vector
-    static size_t UID;
-    //Position of VOTE within hw trait vector
-    static size_t VOTE;
-    //Position of X coordinate within hw trait vector
-    static size_t POSX;
-    //Position of Y coordinate within hw trait vector
-    static size_t POSY;
+    //Instruction and event libraries
+    emp::Ptr<Library> mLib;
+    //Will delete mLib when done
+    bool mOwnLib;
     //Instruction Library for hardware
     emp::Ptr<inst_lib_t> inst_lib;
     //Event Library for hardware
@@ -253,44 +330,218 @@ class Experiment
     size_t MIN_FUN_LEN;
     size_t MAX_FUN_LEN;
     size_t MAX_TOT_LEN;
-};
 
-size_t Experiment::UID = 0;
-size_t Experiment::VOTE = 0;
-size_t Experiment::POSX = 0;
-size_t Experiment::POSY = 0;
+    /* PREFILTER SPECIFIC PARAMATERS */
+
+    //Binding threshold of the hardware, for Library::IsInert
+    double MIN_BIN_THSH;
+    //Will inert genomes be skipped
+    bool SKIP_INERT;
+    //Evaluations and skipped evaluations this generation
+    size_t mEvalCnt = 0;
+    size_t mInertCnt = 0;
+
+    /* TRAFFIC SPECIFIC PARAMATERS */
+
+    //Score lost per mail copy sent per node, see Experiment::Adjust
+    double TRAFFIC_COST;
+
+    /* ARCHIVE SPECIFIC PARAMATERS */
+
+    //Base name of the archive files
+    std::string ARCHIVE_FILE;
+    //Number of agents archived per snapshot
+    size_t ARCHIVE_TOP;
+    //Where the final ancestry goes
+    std::string LINEAGE_FILE;
+    //Base name of the snapshot traces, empty for none
+    std::string TRACE_FILE;
+
+    /* STATUS SPECIFIC PARAMATERS */
+
+    //Mapped file live metrics go to, empty for none
+    std::string STATUS_FILE;
+    Status mStatus;
+    //Evaluations since the run started
+    size_t mTotalEvals = 0;
+    //Mean score and agents promoted by the screen this generation
+    double mMeanScore = 0;
+    size_t mPromoted = 0;
+
+    /* SCREENING SPECIFIC PARAMATERS */
+
+    //Dimension of the screening graph
+    size_t SCREEN_DIM;
+    //Iterations of a screening run
+    size_t SCREEN_ITER;
+    //Fraction promoted to the full graph
+    double SCREEN_FRAC;
+    //Theoretical max of a screening run
+    size_t SCREEN_MAX;
+    //Screening score of every agent, on the full scale
+    std::vector<double> mScreenScores;
+    //Agents in order of screening score
+    std::vector<size_t> mScreenOrder;
+    //Full graph rank of every promoted agent
+    std::vector<size_t> mScreenRank;
+
+    /* ADVERSARY SPECIFIC PARAMATERS */
+
+    //Graph and scratch program owned by one evaluation thread
+    struct EvalWorker
+    {
+      emp::Ptr<Graph> mGraph;
+      emp::Ptr<program_t> mProgram;
+    };
+
+    //Is the adversarial mode on
+    bool ADVERSARIAL;
+    //Enemy nodes per graph
+    size_t NUM_ENE;
+    //Size of the enemy population
+    size_t ENE_POP_SIZE;
+    //Number of evaluation threads
+    size_t EVAL_THREADS;
+    //Enemy population
+    std::vector<Agent> mEnemies;
+    //Enemy genomes, unpacked once per generation
+    std::vector<program_t> mEnemyPrograms;
+    //One per evaluation thread
+    std::vector<EvalWorker> mWorkers;
+    emp::Ptr<ThreadPool> mPool = nullptr;
+    //Enemy faced and score of game e of agent i, at i * EVAL_SIZE + e
+    std::vector<size_t> mOpponents;
+    std::vector<double> mMatrix;
+
+    /* REPRODUCTION SPECIFIC PARAMATERS */
+
+    //Mutator, generator and streams owned by one reproduction thread
+    struct Breeder
+    {
+      emp::Ptr<Mutator> mMutant;
+      //Reseeded from mMutate for every offspring
+      emp::Ptr<emp::Random> mRng;
+      StreamRandom mSelect;
+      StreamRandom mMutate;
+    };
+
+    //Number of reproduction threads
+    size_t REPRO_THREADS;
+    //One per reproduction thread, breeder 0 also mutates the enemies
+    std::vector<Breeder> mBreeders;
+    //Only with REPRO_THREADS > 1, started by Run after the farm is forked
+    emp::Ptr<ThreadPool> mReproPool = nullptr;
+    //Parent of every offspring, and whether it mutated
+    std::vector<size_t> mParents;
+    std::vector<uint8_t> mMutated;
+
+    /* INSTRUMENTATION SPECIFIC PARAMATERS */
+
+    //Most allocations per agent evaluated, see AllocStats.h
+    size_t ALLOC_BUDGET;
+    //Allocations made by this experiment, on any of its threads
+    AllocStats mAllocs;
+
+    /* FARM SPECIFIC PARAMATERS */
+
+    //Worker processes, only with FARM_PROCS > 0
+    emp::Ptr<Farm> mFarm = nullptr;
+    //Genome of every agent and what the workers sent back
+    std::vector<size_t> mFarmIds;
+    std::vector<const PackedGenome *> mFarmGenomes;
+    std::vector<Farm::Result> mFarmResults;
+};
 
 /* FUNCTIONS DEDICATED TO THE EXPERIMENT */
 
+//Will return if config can run as an experiment, printing why not to os
+//Adversarial games and screening run in this process, so they can not use a farm
+bool Experiment::CheckConfig(const HPConfig & config, std::ostream & os)
+{
+  if(!Graph::CheckConfig(config, os))
+    return false;
+
+  if(config.FARM_PROCS() && (config.ADVERSARIAL() || config.SCREEN_DIM()))
+  {
+    os << "FARM_PROCS can not be used with ADVERSARIAL or SCREEN_DIM." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
 //Run the experiment
-void Experiment::Run()
+//The farm is forked by Config_All, before any thread of this process starts
+bool Experiment::Run()
 {
-  std::cout << "SETTING UP CONFIGS!" << std::endl;
+  *mOut << "SETTING UP CONFIGS!" << std::endl;
   Experiment::Config_All();
-  std::cout << "CONFIGS SET!" << std::endl;
+  *mOut << "CONFIGS SET!" << std::endl;
+  if(REPRO_THREADS > 1 && !mReproPool)
+    mReproPool = emp::NewPtr<ThreadPool>(REPRO_THREADS);
+  mArchive->Open();
+  if(!STATUS_FILE.empty())
+    mStatus.Open(STATUS_FILE);
+  if(ALLOC_BUDGET && !AllocStats::ENABLED)
+    *mOut << "ALLOC_BUDGET is ignored, allocations are only counted after make alloc-stats." << std::endl;
+
+  using clock_t = std::chrono::steady_clock;
+  clock_t::time_point start = clock_t::now();
+  mTotalEvals = 0;
 
   for(size_t i = 0; i < NUM_GENS; ++i)
   {
-    std::cout << "GEN: " << i;
+    mGen = i;
+    *mOut << "GEN: " << i;
+    clock_t::time_point gen_start = clock_t::now();
     size_t best_org = Experiment::Evaluation_step();
+    std::chrono::duration<double> eval_secs = clock_t::now() - gen_start;
     if((i%SNAP_SHOT) == 0)
     {
-      std::cout << std::endl;
-      Agent & agent = mWorld->GetOrg(best_org);
-      agent.mGenome.PrintProgramFull();
-      std::cout << std::endl;
+      Experiment::Snapshot_step();
+    }
+    if(i == NUM_GENS - 1)
+    {
+      std::ofstream lineage(LINEAGE_FILE);
+      mLineage.PrintAncestry(best_org, lineage);
     }
     Experiment::Selection_step();
     Experiment::Update_step();
+    if(ADVERSARIAL)
+    {
+      Experiment::Enemy_step();
+    }
+
+    clock_t::time_point now = clock_t::now();
+    Experiment::Status_step(i, std::chrono::duration<double>(now - start).count(),
+                            std::chrono::duration<double>(now - gen_start).count(), eval_secs.count());
+
+    //Only counts in an HP_ALLOC_STATS build
+    //Inert genomes are not run, adversarial games are not counted by Evaluate
+    if(AllocStats::ENABLED)
+    {
+      size_t evals = ADVERSARIAL ? POP_SIZE * EVAL_SIZE : mEvalCnt - mInertCnt;
+      size_t per_eval = evals ? mAllocs.GetEvalAllocs() / evals : 0;
+      mAllocs.Report(*mOut);
+
+      if(ALLOC_BUDGET && per_eval > ALLOC_BUDGET)
+      {
+        *mOut << "Allocations per evaluation " << per_eval << " passed ALLOC_BUDGET " << ALLOC_BUDGET << std::endl;
+        mArchive->Close();
+        return false;
+      }
+    }
   }
+
+  mArchive->Close();
+  return true;
 }
 
 //Confiugre all the neccesary things
 void Experiment::Config_All()
 {
-  Experiment::Config_Inst();
-  Experiment::Config_Events();
   Experiment::Config_World();
+  mLineage.Reset(POP_SIZE);
 
   program_t pro = Experiment::Genome_NOP();
   //program_t pro = Experiment::Genome_ADVANCE();  
@@ -298,38 +549,81 @@ void Experiment::Config_All()
 
   Experiment::Config_HW(pro);
 
+  //Enemies start from the same ancestor
+  if(ADVERSARIAL)
+  {
+    mEnemies.assign(ENE_POP_SIZE, Agent(pro));
+    mEnemyPrograms.assign(ENE_POP_SIZE, program_t(inst_lib));
+  }
+
 
-  std::cout << "CREATING THE GRAPH!" << std::endl;
+  *mOut << "CREATING THE GRAPH!" << std::endl;
   mGraph->CreateGraph(GRA_DIM, GRA_TYPE, inst_lib, event_lib);
   mGraph->ConfigureTraits();
   mGraph->CreateAdjList(GRA_TYPE, GRA_DIM);
-  std::cout << "GRAPH CREATED!" << std::endl;
+  if(mScreen)
+  {
+    mScreen->CreateGraph(SCREEN_DIM, GRA_TYPE, inst_lib, event_lib);
+    mScreen->ConfigureTraits();
+    mScreen->CreateAdjList(GRA_TYPE, SCREEN_DIM);
+  }
+  for(auto & w : mWorkers)
+  {
+    w.mGraph->CreateGraph(GRA_DIM, GRA_TYPE, inst_lib, event_lib);
+    w.mGraph->ConfigureTraits();
+    w.mGraph->CreateAdjList(GRA_TYPE, GRA_DIM);
+  }
+  *mOut << "GRAPH CREATED!" << std::endl;
+
+  //Workers are forked with the graph already built
+  if(mFarm && !mFarm->Start())
+  {
+    *mOut << "Failed to start the farm, evaluating in this process." << std::endl;
+    mFarm.Delete();
+    mFarm = nullptr;
+  }
 }
 
 //Evalute each agent for 
 size_t Experiment::Evaluation_step()
 {
+  PhaseScope phase(PHASE_EVALUATION, &mAllocs);
   double best = -999;
   size_t best_org = 0;
-  for(size_t i = 0; i < POP_SIZE; ++i)
+  mGraph->GetBudget().ClearReport();
+  mGraph->GetTrafficReport().ClearReport();
+  mEvalCnt = mInertCnt = 0;
+  mMeanScore = 0;
+  mPromoted = POP_SIZE;
+
+  if(ADVERSARIAL)
+  {
+    Experiment::Adversary_step();
+  }
+
+  else if(mScreen)
   {
-    mCount = 0;
-    mGraph->Reset();
-    Agent & agent = mWorld->GetOrg(i);
-    program_t & pro = agent.GetGenome();
-    mGraph->SetGenome(pro);
-    double score = mGraph->RunGraph();
+    Experiment::Screen_step();
+  }
+
+  else if(mFarm)
+  {
+    Experiment::Farm_step();
+  }
 
-    if(mCount > 10)
+  else
+  {
+    for(size_t i = 0; i < POP_SIZE; ++i)
     {
-      score += 1;
+      mPop[i].mScore = Experiment::Evaluate(*mGraph, i);
     }
+  }
 
-    else
-    {
-      score += (mCount * VALUE);
-    }    
-    agent.mScore = score;
+  for(size_t i = 0; i < POP_SIZE; ++i)
+  {
+    double score = mPop[i].mScore;
+    mLineage.Score(i, score);
+    mMeanScore += score / POP_SIZE;
 
     if(score > best)
     {
@@ -339,235 +633,577 @@ size_t Experiment::Evaluation_step()
     }    
   }
 
-  std::cout << " Best Score: " << best  << " THEORY_MAX: " << THEORY_MAX << " SUCESS%: " << (best / THEORY_MAX) << std::endl;
+  *mOut << " Best Score: " << best  << " THEORY_MAX: " << THEORY_MAX << " SUCESS%: " << (best / THEORY_MAX);
+  mGraph->GetBudget().PrintReport(*mOut);
+  mGraph->GetTrafficReport().PrintReport(*mOut);
+  *mOut << " TAXA: " << mLineage.GetTaxaCnt();
+  *mOut << " INERT: " << mInertCnt << "/" << mEvalCnt;
+  *mOut << std::endl;
+  mBestScores.push_back(best);
   return best_org;
 }
 
-//Selection
-void Experiment::Selection_step()
+//Will run agent id on graph and return its score
+double Experiment::Evaluate(Graph & graph, size_t id, size_t trial)
 {
-  emp::TournamentSelect(*mWorld, TOURN_SIZE, POP_SIZE);
+  return Experiment::Evaluate(graph, mPop[id].GetGenome(), id, trial);
 }
 
-//Update
-void Experiment::Update_step()
+//Will run genome as agent id on graph and return its score
+double Experiment::Evaluate(Graph & graph, const PackedGenome & genome, size_t id, size_t trial)
 {
-  mWorld->Update();
-  mWorld->DoMutations();
+  genome.Unpack(*mProgram);
+  ++mEvalCnt;
+
+  //Nothing votes, so RunGraph would give 0, unless instructions alone can overrun
+  if(SKIP_INERT && !graph.GetBudget().LimitsInsts() && mLib->IsInert(*mProgram, MIN_BIN_THSH))
+  {
+    ++mInertCnt;
+    return 0.0;
+  }
+
+  graph.SetStream(mGen, id, trial);
+  graph.Reset();
+  graph.SetGenome(*mProgram);
+
+  return Experiment::Adjust(graph, graph.RunGraph(), TRAFFIC_COST);
 }
 
-//Return an genome full of nops
-program_t Experiment::Genome_NOP()
+//Will turn a RunGraph score into a fitness: vote bonus and traffic cost, or the overrun score
+//The cost is per copy sent per node, so the same protocol pays the same on any GRA_DIM
+double Experiment::Adjust(Graph & graph, double score, double traffic_cost)
 {
-  program_t ancestor_prog(inst_lib);
-  std::ifstream ancestor_fstream(NOP_PATH);
+  //Overruns keep the penalty score from RunGraph
+  if(graph.IsOverrun())
+  {
+    return graph.GetBudget().OVERRUN_SCORE;
+  }
 
-  if (!ancestor_fstream.is_open())
+  return Experiment::Adjust(score, graph.GetVoteCount(), graph.GetTraffic().mSent, graph.GetNodeCnt(), traffic_cost);
+}
+
+//Will add the vote bonus and take the traffic cost of sent mail over nodes from score
+//Shard::Evaluate merges these counts over its bands, so both score alike
+double Experiment::Adjust(double score, double votes, size_t sent, size_t nodes, double traffic_cost)
+{
+  if(votes > 10)
   {
-    std::cout << "Failed to open ancestor program file(" << NOP_PATH << "). Exiting..." << std::endl;
-    exit(-1);
+    score += 1;
   }
 
-  ancestor_prog.Load(ancestor_fstream);
+  else
+  {
+    score += (votes * VALUE);
+  }
 
-  return ancestor_prog;
+  if(traffic_cost > 0.0 && nodes)
+  {
+    score -= traffic_cost * sent / nodes;
+  }
+
+  return score;
 }
 
-//Return basic program
-program_t Experiment::Genome_BASIC()
+//Will score every agent on the worker processes of mFarm
+void Experiment::Farm_step()
 {
-  program_t ancestor_prog(inst_lib);
-  std::ifstream ancestor_fstream(BASIC_PATH);
+  mFarmIds.resize(POP_SIZE);
+  mFarmGenomes.resize(POP_SIZE);
+  for(size_t i = 0; i < POP_SIZE; ++i)
+  {
+    mFarmIds[i] = i;
+    mFarmGenomes[i] = &mPop[i].GetGenome();
+  }
 
-  if (!ancestor_fstream.is_open())
+  mFarm->Evaluate(mGen, mFarmIds, mFarmGenomes, mFarmResults);
+
+  //Overruns and mail are counted in the workers, so they are added here
+  for(size_t i = 0; i < POP_SIZE; ++i)
   {
-    std::cout << "Failed to open ancestor program file(" << BASIC_PATH << "). Exiting..." << std::endl;
-    exit(-1);
+    const Farm::Result & result = mFarmResults[i];
+    mPop[i].mScore = result.mScore;
+    mInertCnt += result.mInert;
+    mGraph->GetBudget().AddOverrun((Budget::Reason) result.mReason);
+    if(!result.mInert)
+      mGraph->GetTrafficReport().Add(result.mTraffic);
   }
+  mEvalCnt += POP_SIZE;
 
-  ancestor_prog.Load(ancestor_fstream);
+  if(mFarm->GetRestarts() || mFarm->GetAbandoned())
+    *mOut << " RESTARTS: " << mFarm->GetRestarts() << " ABANDONED: " << mFarm->GetAbandoned();
+}
 
-  return ancestor_prog;
+//Will screen every agent on mScreen, then promote the best SCREEN_FRAC to mGraph
+//Screening scores are scaled by THEORY_MAX / SCREEN_MAX so both runs share a scale.
+//An agent that is not promoted keeps its scaled screening score, capped at the
+//worst promoted score so it never outranks an agent the full graph has seen.
+void Experiment::Screen_step()
+{
+  double scale = (double) THEORY_MAX / SCREEN_MAX;
+  mScreenScores.resize(POP_SIZE);
+  mScreenOrder.resize(POP_SIZE);
+
+  for(size_t i = 0; i < POP_SIZE; ++i)
+  {
+    double score = Experiment::Evaluate(*mScreen, i, 1);
+    mScreenScores[i] = mScreen->IsOverrun() ? score : score * scale;
+    mScreenOrder[i] = i;
+  }
+
+  std::stable_sort(mScreenOrder.begin(), mScreenOrder.end(), [this](size_t a, size_t b)
+  {
+    return mScreenScores[a] > mScreenScores[b];
+  });
+
+  size_t promote = std::max<size_t>(1, std::min<size_t>(POP_SIZE, SCREEN_FRAC * POP_SIZE + 0.5));
+  mPromoted = promote;
+  double worst = 0;
+
+  for(size_t k = 0; k < promote; ++k)
+  {
+    size_t id = mScreenOrder[k];
+    double score = Experiment::Evaluate(*mGraph, id);
+    mPop[id].mScore = score;
+    worst = (k == 0) ? score : std::min(worst, score);
+  }
+
+  for(size_t k = promote; k < POP_SIZE; ++k)
+  {
+    size_t id = mScreenOrder[k];
+    mPop[id].mScore = std::min(mScreenScores[id], worst);
+  }
+
+  //How well the screen ranked the promoted agents (Spearman), and how many
+  //of them the full graph scored below what the best rejected agent screened at
+  std::vector<size_t> full(mScreenOrder.begin(), mScreenOrder.begin() + promote);
+  std::stable_sort(full.begin(), full.end(), [this](size_t a, size_t b)
+  {
+    return mPop[a].mScore > mPop[b].mScore;
+  });
+
+  mScreenRank.assign(POP_SIZE, 0);
+  for(size_t k = 0; k < promote; ++k)
+    mScreenRank[full[k]] = k;
+
+  double d2 = 0;
+  size_t miss = 0;
+  double cutoff = (promote < POP_SIZE) ? mScreenScores[mScreenOrder[promote]] : -999;
+
+  for(size_t k = 0; k < promote; ++k)
+  {
+    size_t id = mScreenOrder[k];
+    double d = (double) mScreenRank[id] - k;
+    d2 += d * d;
+
+    if(mPop[id].mScore < cutoff)
+      ++miss;
+  }
+
+  double rho = (promote > 1) ? 1 - 6 * d2 / (promote * ((double) promote * promote - 1)) : 1;
+  *mOut << " SCREEN: " << promote << "/" << POP_SIZE << " RHO: " << rho << " MISS: " << miss;
 }
 
-//Return advance program
-program_t Experiment::Genome_ADVANCE()
+//Will play every agent against EVAL_SIZE enemies and fill the score matrix
+//Enemies are dealt from a reshuffled deck so each plays about as often as the
+//others. An agent scores the mean of its games, an enemy scores THEORY_MAX
+//minus the mean of the games it played.
+void Experiment::Adversary_step()
 {
-  program_t ancestor_prog(inst_lib);
-  std::ifstream ancestor_fstream(ADVANCE_PATH);
+  for(size_t k = 0; k < ENE_POP_SIZE; ++k)
+  {
+    mEnemies[k].mGenome.Unpack(mEnemyPrograms[k]);
+  }
 
-  if (!ancestor_fstream.is_open())
+  size_t games = POP_SIZE * EVAL_SIZE;
+  std::vector<size_t> deck(ENE_POP_SIZE);
+  for(size_t k = 0; k < ENE_POP_SIZE; ++k)
+    deck[k] = k;
+
+  mOpponents.resize(games);
+  mMatrix.assign(games, 0.0);
+  mSelectStream.SetStream(mGen, 0, 1);
+
+  for(size_t g = 0; g < games; ++g)
   {
-    std::cout << "Failed to open ancestor program file(" << ADVANCE_PATH << "). Exiting..." << std::endl;
-    exit(-1);
+    if(g % ENE_POP_SIZE == 0)
+      mSelectStream.Shuffle(deck);
+    mOpponents[g] = deck[g % ENE_POP_SIZE];
   }
 
-  ancestor_prog.Load(ancestor_fstream);
+  //Every worker takes a contiguous batch of agents
+  size_t batch = (POP_SIZE + EVAL_THREADS - 1) / EVAL_THREADS;
+  for(size_t w = 0; w < EVAL_THREADS; ++w)
+  {
+    size_t begin = std::min(POP_SIZE, w * batch);
+    size_t end = std::min(POP_SIZE, begin + batch);
+    mPool->Push([this, w, begin, end]() {this->Adversary_batch(w, begin, end);});
+  }
+  mPool->Wait();
 
-  return ancestor_prog;
+  std::vector<double> total(ENE_POP_SIZE, 0.0);
+  std::vector<size_t> played(ENE_POP_SIZE, 0);
+
+  for(size_t i = 0; i < POP_SIZE; ++i)
+  {
+    double sum = 0.0;
+    for(size_t e = 0; e < EVAL_SIZE; ++e)
+    {
+      size_t g = i * EVAL_SIZE + e;
+      sum += mMatrix[g];
+      total[mOpponents[g]] += mMatrix[g];
+      played[mOpponents[g]] += 1;
+    }
+    mPop[i].mScore = EVAL_SIZE ? sum / EVAL_SIZE : 0.0;
+  }
+
+  double best_bad = 0.0;
+  for(size_t k = 0; k < ENE_POP_SIZE; ++k)
+  {
+    mEnemies[k].mScore = played[k] ? THEORY_MAX - total[k] / played[k] : 0.0;
+    best_bad = std::max(best_bad, mEnemies[k].mScore);
+  }
+
+  for(auto & w : mWorkers)
+  {
+    mGraph->GetBudget().MergeReport(w.mGraph->GetBudget());
+    w.mGraph->GetBudget().ClearReport();
+    mGraph->GetTrafficReport().MergeReport(w.mGraph->GetTrafficReport());
+    w.mGraph->GetTrafficReport().ClearReport();
+  }
+
+  *mOut << " GAMES: " << games << " Best Enemy: " << best_bad;
 }
 
+//Will play agents [begin, end) on worker w
+//The good genome is unpacked and loaded once, then only the enemy nodes change
+void Experiment::Adversary_batch(size_t w, size_t begin, size_t end)
+{
+  PhaseScope phase(PHASE_EVALUATION, &mAllocs);
+  Graph & graph = *mWorkers[w].mGraph;
+  program_t & good = *mWorkers[w].mProgram;
 
-/* FUNCTIONS DEDICATED TO THE CONFIGURATIONS, INSTRUCTIONS, EVENTS */
-
-//Will make the instruction library
-void Experiment::Config_Inst()
-{
-
-  //Experiment specific instructions
-  inst_lib->AddInst("GetUID", Inst_GetUID, 1, "UID => Local Memory Arg1");
-  inst_lib->AddInst("Broadcast", Inst_BroadcastMail, 1, "Output Memory => hw.neighboors");
-  //inst_lib->AddInst("BroadcastVote", Inst_BroadcastVote, 1, "Output Memory[Arg1] = Vote => hw.neighboors");
-  inst_lib->AddInst("GetVote", Inst_GetVote, 1, "Vote => Local Memory Arg1");
-  inst_lib->AddInst("SetVote", Inst_SetVote, 1, "Local Memory Arg1 => Hw.Trait[VOTE]");
-
-  // - Setup the instruction set. -
-  // Standard instructions:
-
-  inst_lib->AddInst("Inc", hardware_t::Inst_Inc, 1, "Increment value in local memory Arg1");
-  inst_lib->AddInst("Dec", hardware_t::Inst_Dec, 1, "Decrement value in local memory Arg1");
-  inst_lib->AddInst("Not", hardware_t::Inst_Not, 1, "Logically toggle value in local memory Arg1");
-  inst_lib->AddInst("Add", hardware_t::Inst_Add, 3, "Local memory: Arg3 = Arg1 + Arg2");
-  inst_lib->AddInst("Sub", hardware_t::Inst_Sub, 3, "Local memory: Arg3 = Arg1 - Arg2");
-  inst_lib->AddInst("Mult", hardware_t::Inst_Mult, 3, "Local memory: Arg3 = Arg1 * Arg2");
-  inst_lib->AddInst("Div", hardware_t::Inst_Div, 3, "Local memory: Arg3 = Arg1 / Arg2");
-  inst_lib->AddInst("Mod", hardware_t::Inst_Mod, 3, "Local memory: Arg3 = Arg1 % Arg2");
-  inst_lib->AddInst("TestEqu", hardware_t::Inst_TestEqu, 3, "Local memory: Arg3 = (Arg1 == Arg2)");
-  inst_lib->AddInst("TestNEqu", hardware_t::Inst_TestNEqu, 3, "Local memory: Arg3 = (Arg1 != Arg2)");
-  inst_lib->AddInst("TestLess", hardware_t::Inst_TestLess, 3, "Local memory: Arg3 = (Arg1 < Arg2)");
-  inst_lib->AddInst("If", hardware_t::Inst_If, 1, "Local memory: If Arg1 != 0, proceed; else, skip block.", emp::ScopeType::BASIC, 0, {"block_def"});
-  inst_lib->AddInst("While", hardware_t::Inst_While, 1, "Local memory: If Arg1 != 0, loop; else, skip block.", emp::ScopeType::BASIC, 0, {"block_def"});
-  inst_lib->AddInst("Countdown", hardware_t::Inst_Countdown, 1, "Local memory: Countdown Arg1 to zero.", emp::ScopeType::BASIC, 0, {"block_def"});
-  inst_lib->AddInst("Close", hardware_t::Inst_Close, 0, "Close current block if there is a block to close.", emp::ScopeType::BASIC, 0, {"block_close"});
-  inst_lib->AddInst("Break", hardware_t::Inst_Break, 0, "Break out of current block.");
-  inst_lib->AddInst("Call", hardware_t::Inst_Call, 0, "Call function that best matches call affinity.", emp::ScopeType::BASIC, 0, {"affinity"});
-  inst_lib->AddInst("Return", hardware_t::Inst_Return, 0, "Return from current function if possible.");
-  inst_lib->AddInst("SetMem", hardware_t::Inst_SetMem, 2, "Local memory: Arg1 = numerical value of Arg2");
-  inst_lib->AddInst("CopyMem", hardware_t::Inst_CopyMem, 2, "Local memory: Arg1 = Arg2");
-  inst_lib->AddInst("SwapMem", hardware_t::Inst_SwapMem, 2, "Local memory: Swap values of Arg1 and Arg2.");
-  inst_lib->AddInst("Input", hardware_t::Inst_Input, 2, "Input memory Arg1 => Local memory Arg2.");
-  inst_lib->AddInst("Output", hardware_t::Inst_Output, 2, "Local memory Arg1 => Output memory Arg2.");
-  inst_lib->AddInst("Commit", hardware_t::Inst_Commit, 2, "Local memory Arg1 => Shared memory Arg2.");
-  inst_lib->AddInst("Pull", hardware_t::Inst_Pull, 2, "Shared memory Arg1 => Local memory Arg2.");
-  inst_lib->AddInst("Nop", hardware_t::Inst_Nop, 0, "No operation.");
+  for(size_t i = begin; i < end; ++i)
+  {
+    mPop[i].GetGenome().Unpack(good);
+    graph.SetGenome(good);
 
-  
+    for(size_t e = 0; e < EVAL_SIZE; ++e)
+    {
+      size_t g = i * EVAL_SIZE + e;
+      graph.SetStream(mGen, i, e);
+      graph.SetEnemies(mEnemyPrograms[mOpponents[g]], good, NUM_ENE);
+      graph.Reset();
+      mMatrix[g] = Experiment::Adjust(graph, graph.RunGraph(), TRAFFIC_COST);
+    }
+  }
 }
 
-//Will set the output memory of a hardware to all of its neighboors
-void Experiment::Inst_BroadcastMail(hardware_t & hw, const inst_t & inst)
+//Will select and mutate the enemy population
+//Same tournament and mutation as the good population, on their own streams
+void Experiment::Enemy_step()
 {
-  state_t & state = hw.GetCurState();
-  hw.TriggerEvent("BroadcastMail", inst.affinity, state.output_mem);
+  PhaseScope phase(PHASE_SELECTION, &mAllocs);
+  mSelectStream.SetStream(mGen, 0, 2);
+  std::vector<Agent> next;
+  next.reserve(ENE_POP_SIZE);
+
+  for(size_t k = 0; k < ENE_POP_SIZE; ++k)
+  {
+    size_t best = mSelectStream.GetUInt(ENE_POP_SIZE);
+    for(size_t t = 1; t < TOURN_SIZE; ++t)
+    {
+      size_t id = mSelectStream.GetUInt(ENE_POP_SIZE);
+      if(mEnemies[id].mScore > mEnemies[best].mScore)
+        best = id;
+    }
+
+    next.push_back(mEnemies[best]);
+  }
+
+  mEnemies.swap(next);
+
+  for(size_t k = 0; k < ENE_POP_SIZE; ++k)
+  {
+    Experiment::Mutate(0, mEnemies[k], k, 1);
+  }
 }
 
-//Will set the output memory of a hardware to all of its neighboors
-void Experiment::Inst_BroadcastVote(hardware_t & hw, const inst_t & inst)
+//Selection
+//Same tournament as emp::TournamentSelect, only parent indices are picked here
+//Births are recorded after the batches, Lineage is not shared between threads
+void Experiment::Selection_step()
 {
-  double vote = hw.GetTrait(VOTE);
-  state_t & state = hw.GetCurState();
-  state.SetOutput(inst.args[0], vote);
+  PhaseScope phase(PHASE_SELECTION, &mAllocs);
+  Experiment::Breed([this](size_t w, size_t begin, size_t end) {this->Selection_batch(w, begin, end);});
 
-  hw.TriggerEvent("BroadcastVote", inst.affinity, state.output_mem);
+  for(size_t k = 0; k < POP_SIZE; ++k)
+    mLineage.Birth(k, mParents[k]);
 }
 
-//Will load the UID of a hardware into its working buffer
-void Experiment::Inst_GetUID(hardware_t & hw, const inst_t & inst)
+//Will pick the parents of offspring [begin, end) on breeder w
+//Offspring k draws its tournament from stream (mGen, k), so the parents do not
+//depend on the number of threads
+void Experiment::Selection_batch(size_t w, size_t begin, size_t end)
 {
-  state_t & state = hw.GetCurState();
-  state.SetLocal(inst.args[0], hw.GetTrait(UID));
+  PhaseScope phase(PHASE_SELECTION, &mAllocs);
+  StreamRandom & rnd = mBreeders[w].mSelect;
+
+  for(size_t k = begin; k < end; ++k)
+  {
+    rnd.SetStream(mGen, k);
+    size_t best = rnd.GetUInt(POP_SIZE);
+    for(size_t t = 1; t < TOURN_SIZE; ++t)
+    {
+      size_t id = rnd.GetUInt(POP_SIZE);
+      if(mPop[id].mScore > mPop[best].mScore)
+        best = id;
+    }
+
+    mParents[k] = best;
+  }
 }
 
-//Will get the vote of a hardware
-void Experiment::Inst_GetVote(hardware_t & hw, const inst_t & inst)
+//Update
+//Offspring are bred into mNext, which then becomes the population
+void Experiment::Update_step()
 {
-  state_t & state = hw.GetCurState();
-  state.SetLocal(inst.args[0], hw.GetTrait(VOTE));
+  PhaseScope phase(PHASE_UPDATE, &mAllocs);
+  Experiment::Breed([this](size_t w, size_t begin, size_t end) {this->Update_batch(w, begin, end);});
+
+  mPop.swap(mNext);
+  mLineage.Update();
+
+  for(size_t i = 0; i < POP_SIZE; ++i)
+  {
+    if(mMutated[i])
+      mLineage.Mutated(i, mGen + 1);
+  }
 }
 
-//Will set the vote of the hardware
-void Experiment::Inst_SetVote(hardware_t & hw, const inst_t & inst)
+//Will copy and mutate offspring [begin, end) into mNext on breeder w
+//Each offspring mutates from its own stream, so the result does not depend on order.
+//The genome buffers of mNext are reused, so a copy only allocates when a genome grows.
+void Experiment::Update_batch(size_t w, size_t begin, size_t end)
 {
-  state_t & state = hw.GetCurState();
-  double vote = state.GetLocal(inst.args[0]);
-  hw.SetTrait(VOTE, vote);
+  PhaseScope phase(PHASE_UPDATE, &mAllocs);
+
+  for(size_t k = begin; k < end; ++k)
+  {
+    mNext[k] = mPop[mParents[k]];
+    mMutated[k] = Experiment::Mutate(w, mNext[k], k) != 0;
+  }
 }
 
-//Will make the event library
-void Experiment::Config_Events()
+//Will run batch(w, begin, end) over contiguous slices of the population, one per breeder
+//Runs on this thread when there is a single breeder
+template<typename BATCH>
+void Experiment::Breed(BATCH batch)
 {
-  event_lib->AddEvent("BroadcastMail", Experiment::Handle_Broadcast, "Send output memory to all neighbors.");
-  event_lib->RegisterDispatchFun("BroadcastMail", [this](hardware_t & hw, const event_t & e)
+  if(!mReproPool)
   {
-    // state_t & state = hw.GetCurState();
-    // auto output = state.output_mem;
-    // auto graph = this->mGraph;
+    batch(0, 0, POP_SIZE);
+    return;
+  }
 
-    // for(auto x : output)
-    // {
-    //   if(graph->Find(x.second))
-    //   {
-    //     this->mCount += 1;
-    //     break;
-    //   }
-    // }
+  size_t slice = (POP_SIZE + REPRO_THREADS - 1) / REPRO_THREADS;
+  for(size_t w = 0; w < REPRO_THREADS; ++w)
+  {
+    size_t begin = std::min(POP_SIZE, w * slice);
+    size_t end = std::min(POP_SIZE, begin + slice);
+    mReproPool->Push([batch, w, begin, end]() {batch(w, begin, end);});
+  }
+  mReproPool->Wait();
+}
 
-    this->Dispatch_Broadcast(hw, e);
+//Will hand the ARCHIVE_TOP best agents to the archive writer, and trace the best one
+//Only copies the packed genomes, packing and writing happen on the writer thread
+void Experiment::Snapshot_step()
+{
+  PhaseScope phase(PHASE_SNAPSHOT, &mAllocs);
+  std::vector<size_t> order(POP_SIZE);
+  for(size_t i = 0; i < POP_SIZE; ++i)
+    order[i] = i;
+
+  size_t top = std::min(ARCHIVE_TOP, POP_SIZE);
+  std::partial_sort(order.begin(), order.begin() + top, order.end(), [this](size_t a, size_t b)
+  {
+    return mPop[a].mScore > mPop[b].mScore;
   });
 
+  std::vector<Elite> elites(top);
+  for(size_t i = 0; i < top; ++i)
+  {
+    Agent & agent = mPop[order[i]];
+    elites[i].mScore = agent.mScore;
+    elites[i].mGenome = agent.mGenome;
+  }
+
+  mArchive->Push(mGen, std::move(elites));
 
-  event_lib->AddEvent("BroadcastVote", Experiment::Handle_Broadcast, "Send output memory to all neighbors.");
-  event_lib->RegisterDispatchFun("BroadcastVote", [this](hardware_t & hw, const event_t & e)
+  //Same stream as its evaluation, so without enemies the rerun is the run it was scored on
+  //An inert best agent is still run, so the trace is never empty
+  if(!TRACE_FILE.empty() && top)
   {
-    auto graph = this->mGraph;
-    double vote = hw.GetTrait(VOTE);
+    //Not an evaluation of this generation: Status_step and the ALLOC_BUDGET
+    //check divide the overrun, traffic and allocation counts by mEvalCnt
+    Budget budget = mGraph->GetBudget();
+    TrafficReport traffic = mGraph->GetTrafficReport();
+    AllocStats allocs;
 
-    if(graph->Find(vote))
     {
-      this->mCount+= 1;
+      PhaseScope rerun(PHASE_SNAPSHOT, &allocs);
+      Trace trace;
+      mPop[order[0]].GetGenome().Unpack(*mProgram);
+      mGraph->SetTrace(&trace);
+      mGraph->SetStream(mGen, order[0]);
+      mGraph->Reset();
+      mGraph->SetGenome(*mProgram);
+      mGraph->RunGraph();
+      mGraph->SetTrace(nullptr);
+      trace.Write(TRACE_FILE + "_" + std::to_string(mGen) + ".hpt");
     }
 
+    mAllocs.Absorb(allocs, PHASE_SNAPSHOT);
+    mGraph->GetBudget().ClearReport();
+    mGraph->GetBudget().MergeReport(budget);
+    mGraph->GetTrafficReport() = traffic;
+  }
+}
 
-    this->Dispatch_Broadcast(hw, e);
-  });
+//Will publish the metrics of generation gen to STATUS_FILE
+//Costs a few stores per generation, readers never touch this process
+void Experiment::Status_step(size_t gen, double elapsed, double gen_secs, double eval_secs)
+{
+  if(!mStatus.IsOpen())
+    return;
+
+  //Adversarial games are not counted by Evaluate
+  size_t evals = ADVERSARIAL ? POP_SIZE * EVAL_SIZE : mEvalCnt;
+  mTotalEvals += evals;
+
+  Status::Record rec;
+  std::memset(&rec, 0, sizeof(rec));
+  rec.mPid = getpid();
+  rec.mGen = gen;
+  rec.mNumGens = NUM_GENS;
+  rec.mUpdated = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  rec.mElapsed = elapsed;
+  rec.mGensPerSec = elapsed > 0 ? (gen + 1) / elapsed : 0;
+  rec.mEvalsPerSec = elapsed > 0 ? mTotalEvals / elapsed : 0;
+  rec.mLastEvalsPerSec = eval_secs > 0 ? evals / eval_secs : 0;
+  rec.mEvals = evals;
+  rec.mSkipRate = mEvalCnt ? (double) mInertCnt / mEvalCnt : 0;
+  rec.mEvalShare = gen_secs > 0 ? eval_secs / gen_secs : 0;
+  rec.mPromoteRate = (double) mPromoted / POP_SIZE;
+  rec.mOverruns = mGraph->GetBudget().GetOverruns();
+  rec.mArchiveQueue = mArchive->GetQueued();
+  rec.mWorkers = mFarm ? mFarm->GetProcs() : (ADVERSARIAL ? EVAL_THREADS : 1);
+  rec.mRestarts = mFarm ? mFarm->GetRestarts() : 0;
+  rec.mBest = mBestScores.back();
+  rec.mMean = mMeanScore;
+  rec.mTheoryMax = THEORY_MAX;
+
+  mStatus.Publish(rec);
+}
+
+//Will print the archived elites of the last snapshot at or before gen
+bool Experiment::PrintArchive(size_t gen, std::ostream & os)
+{
+  std::vector<Elite> elites;
+
+  if(!Archive::Read(ARCHIVE_FILE, gen, elites))
+    return false;
+
+  for(size_t i = 0; i < elites.size(); ++i)
+  {
+    os << "GEN: " << gen << " RANK: " << i << " SCORE: " << elites[i].mScore << std::endl;
+    elites[i].mGenome.Unpack(*mProgram);
+    mProgram->PrintProgramFull(os);
+    os << std::endl;
+  }
+
+  return true;
+}
+
+//Will mutate the genome of agent in place on breeder w, from mutation stream (mGen, id, trial)
+//Returns number of mutations
+size_t Experiment::Mutate(size_t w, Agent & agent, size_t id, size_t trial)
+{
+  Breeder & breeder = mBreeders[w];
+  breeder.mMutate.SetStream(mGen, id, trial);
+  breeder.mRng->ResetSeed(breeder.mMutate.GetSeed());
+  return breeder.mMutant->Mutate(agent.mGenome, *breeder.mRng);
+}
+
+//Return an genome full of nops
+program_t Experiment::Genome_NOP()
+{
+  program_t ancestor_prog(inst_lib);
+  std::ifstream ancestor_fstream(NOP_PATH);
+
+  if (!ancestor_fstream.is_open())
+  {
+    std::cout << "Failed to open ancestor program file(" << NOP_PATH << "). Exiting..." << std::endl;
+    exit(-1);
+  }
+
+  ancestor_prog.Load(ancestor_fstream);
+
+  return ancestor_prog;
 }
 
-//Will spawn a core for the event
-void Experiment::Handle_Broadcast(hardware_t & hw, const event_t & e)
+//Return basic program
+program_t Experiment::Genome_BASIC()
 {
-  hw.SpawnCore(e.affinity, hw.GetMinBindThresh(), e.msg);
+  program_t ancestor_prog(inst_lib);
+  std::ifstream ancestor_fstream(BASIC_PATH);
+
+  if (!ancestor_fstream.is_open())
+  {
+    std::cout << "Failed to open ancestor program file(" << BASIC_PATH << "). Exiting..." << std::endl;
+    exit(-1);
+  }
+
+  ancestor_prog.Load(ancestor_fstream);
+
+  return ancestor_prog;
 }
 
-//Will actually do the event
-void Experiment::Dispatch_Broadcast(hardware_t & hw, const event_t & e)
+//Return advance program
+program_t Experiment::Genome_ADVANCE()
 {
-  coor_t p = std::make_pair(hw.GetTrait(POSX), hw.GetTrait(POSY));
-  auto team = mGraph->GetNodeNeig(p.first, p.second);
+  program_t ancestor_prog(inst_lib);
+  std::ifstream ancestor_fstream(ADVANCE_PATH);
 
-  for(auto pair : team)
+  if (!ancestor_fstream.is_open())
   {
-    auto node = mGraph->GetNode(pair.first, pair.second);
-    node->mHW->QueueEvent(e);
+    std::cout << "Failed to open ancestor program file(" << ADVANCE_PATH << "). Exiting..." << std::endl;
+    exit(-1);
   }
+
+  ancestor_prog.Load(ancestor_fstream);
+
+  return ancestor_prog;
 }
 
-//Will create the hardware
+
+/* FUNCTIONS DEDICATED TO THE CONFIGURATIONS */
+
+//Will fill the population with copies of p
+//mNext starts as a copy too, so its genome buffers are already allocated
 void Experiment::Config_HW(program_t p)
 {
-  mWorld->Inject(p, POP_SIZE);
+  mPop.assign(POP_SIZE, Agent(p));
+  mNext = mPop;
 }
 
-//Will configure the world
+//Will set up the population buffers
 void Experiment::Config_World()
 {
-  mWorld->Reset();
-  mWorld->SetPopStruct_Mixed(true);
-  mWorld->SetFitFun([this](Agent & agent) {return agent.mScore;});
-  mWorld->SetMutFun([this](Agent & agent, emp::Random & rnd)
-  {
-    program_t & p = agent.mGenome;
-    return this->mMutant->ApplyMutations(p, rnd);
-  });
+  mPop.clear();
+  mNext.clear();
+  mParents.assign(POP_SIZE, 0);
+  mMutated.assign(POP_SIZE, 0);
 }
 
 
@@ -735,8 +1371,6 @@ void Experiment::GraphTest5()
 //Will test loading GENOME
 void Experiment::GraphTest6()
 {
-  Experiment::Config_Inst();
-  Experiment::Config_Events();
   Experiment::Config_World();
 
   mGraph->CreateGraph(GRA_DIM, GRA_TYPE, inst_lib, event_lib);
@@ -776,8 +1410,6 @@ void Experiment::GraphTest6()
 //Will test step by step process of the hardware
 void Experiment::GraphTest7()
 {
-  Experiment::Config_Inst();
-  Experiment::Config_Events();
   Experiment::Config_World();
 
   mGraph->CreateGraph(GRA_DIM, GRA_TYPE, inst_lib, event_lib);  
@@ -0,0 +1,629 @@
+#ifndef HP_FARM_H
+#define HP_FARM_H
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hp_config.h"
+#include "PackedGenome.h"
+#include "Budget.h"
+#include "Traffic.h"
+
+/* CLASS USED TO EVALUATE GENOMES IN FORKED WORKER PROCESSES */
+
+//Start forks a zygote, a copy of the coordinator that only forks workers, so
+//every worker, first or replacement, comes from a process with one thread.
+//Start must therefore run before the coordinator starts any thread. Every
+//worker talks to the coordinator over its own socketpair, which the zygote
+//hands over with SCM_RIGHTS. A worker keeps nothing between requests: it
+//gets a batch
+//  [gen u32][count u32] then per agent [index u32][id u32][bytes u32][packed genome]
+//and answers every agent as soon as it is scored
+//  [index u32][Result]  (score, inert, overrun reason and mail counts)
+//so a worker that dies only loses the agents it had not answered yet.
+//A worker that closes its socket, or answers nothing for FARM_TIMEOUT ms,
+//is killed and forked again, and its unanswered agents are queued again.
+//The first unanswered agent is the one it was running; after FARM_RETRIES
+//such failures that agent gets OVERRUN_SCORE instead of another try, so a
+//runaway genome can not stall the run.
+class Farm
+{
+  public:
+    //What a worker sends back for one agent
+    //Copied as bytes, the workers run the same binary as the coordinator
+    struct Result
+    {
+      double mScore = 0.0;
+      //The genome was not run, so mReason and mTraffic are empty
+      bool mInert = false;
+      //Why the evaluation was stopped, Budget::NONE if it was not
+      uint8_t mReason = Budget::NONE;
+      //Mail of the evaluation
+      Traffic mTraffic;
+    };
+
+    //Scores the genome of agent id in generation gen into result
+    //Runs inside the worker, on the state the coordinator had when Start ran
+    using work_t = std::function<void(size_t gen, size_t id, const PackedGenome & genome, Result & result)>;
+
+    Farm(const HPConfig & config, work_t work) :
+    FARM_PROCS(std::max<size_t>(1, config.FARM_PROCS())), FARM_BATCH(std::max<size_t>(1, config.FARM_BATCH())),
+    FARM_TIMEOUT(config.FARM_TIMEOUT()), FARM_RETRIES(std::max<size_t>(1, config.FARM_RETRIES())),
+    OVERRUN_SCORE(config.OVERRUN_SCORE()), mWork(work)
+    {;}
+
+    ~Farm() {Farm::Stop();}
+
+    /* FUNCTIONS DEDICATED TO THE WORKERS */
+
+    //Will fork the zygote and every worker, call once the state they need is
+    //built and before this process starts any thread
+    bool Start();
+
+    //Will close every socket, which ends the workers, and reap the zygote
+    void Stop();
+
+    //Will score genomes[i] as agent ids[i] of generation gen into results[i]
+    void Evaluate(size_t gen, const std::vector<size_t> & ids, const std::vector<const PackedGenome *> & genomes,
+                  std::vector<Result> & results);
+
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return number of workers
+    size_t GetProcs() const {return FARM_PROCS;}
+
+    //Return workers restarted since the last Evaluate
+    size_t GetRestarts() const {return mRestarts;}
+
+    //Return agents given OVERRUN_SCORE after FARM_RETRIES failures since the last Evaluate
+    size_t GetAbandoned() const {return mAbandoned;}
+
+  private:
+    using clock_t = std::chrono::steady_clock;
+
+    struct Worker
+    {
+      pid_t mPid = -1;
+      int mFd = -1;
+      //Indexes of the agents sent and not answered yet, in the order sent
+      std::deque<size_t> mPending;
+      //Bytes of answers not complete yet
+      std::vector<uint8_t> mIn;
+      //When the worker last sent or got something
+      clock_t::time_point mLast;
+    };
+
+    //Bytes of one answer
+    static constexpr size_t REPLY = 4 + sizeof(Result);
+
+    //Will have the zygote fork worker w
+    bool Spawn(size_t w);
+
+    //Loop run by the zygote, forks a worker per request, never returns
+    void Zygote(int ctl);
+
+    //Will pass fd and pid over sock, fd -1 passes only the pid
+    static bool SendFd(int sock, int fd, pid_t pid);
+
+    //Will return the fd passed over sock, -1 if none came, and set pid
+    static int ReceiveFd(int sock, pid_t & pid);
+
+    //Will kill worker w, queue its unanswered agents again and fork it again
+    void Fail(size_t w);
+
+    //Will send a batch from the queue to worker w, false if it is gone
+    bool Send(size_t w);
+
+    //Will read what worker w sent, false if it is gone
+    bool Receive(size_t w);
+
+    //Loop run by a worker, never returns
+    void Work(int fd);
+
+    //Will read or write exactly n bytes, false on end of file or error
+    static bool ReadAll(int fd, void * buf, size_t n);
+    static bool WriteAll(int fd, const void * buf, size_t n);
+
+    template<typename T>
+    static void Put(std::vector<uint8_t> & buf, T v)
+    {
+      size_t off = buf.size();
+      buf.resize(off + sizeof(T));
+      std::memcpy(&buf[off], &v, sizeof(T));
+    }
+
+    //Farm settings
+    size_t FARM_PROCS;
+    size_t FARM_BATCH;
+    size_t FARM_TIMEOUT;
+    size_t FARM_RETRIES;
+    double OVERRUN_SCORE;
+    //Scores one genome inside a worker
+    work_t mWork;
+    std::vector<Worker> mWorkers;
+    //Socket to the zygote, and its pid
+    int mZygote = -1;
+    pid_t mZygotePid = -1;
+
+    //The evaluation being run
+    size_t mGen = 0;
+    const std::vector<size_t> * mIds = nullptr;
+    const std::vector<const PackedGenome *> * mGenomes = nullptr;
+    std::vector<Result> * mResults = nullptr;
+    //Agents not sent yet
+    std::deque<size_t> mQueue;
+    //Failures charged to every agent
+    std::vector<size_t> mStrikes;
+    //Agents answered or abandoned
+    size_t mDone = 0;
+    size_t mRestarts = 0;
+    size_t mAbandoned = 0;
+};
+
+/* FUNCTIONS DEDICATED TO THE WORKERS */
+
+//Will fork the zygote and every worker, call once the state they need is
+//built and before this process starts any thread
+bool Farm::Start()
+{
+  Farm::Stop();
+
+  int fds[2];
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+  {
+    std::cout << "Farm could not open a socket for the zygote." << std::endl;
+    return false;
+  }
+
+  std::cout.flush();
+  pid_t pid = fork();
+
+  if(pid == 0)
+  {
+    close(fds[0]);
+    Farm::Zygote(fds[1]);
+  }
+
+  close(fds[1]);
+
+  if(pid < 0)
+  {
+    std::cout << "Farm could not fork the zygote." << std::endl;
+    close(fds[0]);
+    return false;
+  }
+
+  mZygote = fds[0];
+  mZygotePid = pid;
+  mWorkers.resize(FARM_PROCS);
+
+  for(size_t w = 0; w < FARM_PROCS; ++w)
+  {
+    if(!Farm::Spawn(w))
+      return false;
+  }
+
+  return true;
+}
+
+//Will close every socket, which ends the workers, and reap the zygote
+//A worker reads end of file on its socket and exits by itself, the zygote
+//reaps the workers, and exits once its own socket closes
+void Farm::Stop()
+{
+  for(Worker & worker : mWorkers)
+  {
+    if(worker.mFd >= 0)
+      close(worker.mFd);
+  }
+
+  mWorkers.clear();
+
+  if(mZygote >= 0)
+    close(mZygote);
+  if(mZygotePid > 0)
+    waitpid(mZygotePid, nullptr, 0);
+  mZygote = -1;
+  mZygotePid = -1;
+}
+
+//Will have the zygote fork worker w
+bool Farm::Spawn(size_t w)
+{
+  uint8_t request = 1;
+  pid_t pid = -1;
+  int fd = -1;
+
+  if(mZygote >= 0 && Farm::WriteAll(mZygote, &request, 1))
+    fd = Farm::ReceiveFd(mZygote, pid);
+
+  if(fd < 0)
+  {
+    std::cout << "Farm could not fork worker " << w << "." << std::endl;
+    return false;
+  }
+
+  Worker & worker = mWorkers[w];
+  worker.mPid = pid;
+  worker.mFd = fd;
+  worker.mPending.clear();
+  worker.mIn.clear();
+  worker.mLast = clock_t::now();
+  return true;
+}
+
+//Will kill worker w, queue its unanswered agents again and fork it again
+//The zygote reaps the worker
+void Farm::Fail(size_t w)
+{
+  Worker & worker = mWorkers[w];
+
+  if(worker.mPid > 0)
+    kill(worker.mPid, SIGKILL);
+  if(worker.mFd >= 0)
+    close(worker.mFd);
+  worker.mPid = -1;
+  worker.mFd = -1;
+  ++mRestarts;
+
+  //The first unanswered agent is the one the worker was running
+  if(!worker.mPending.empty())
+  {
+    size_t culprit = worker.mPending.front();
+    worker.mPending.pop_front();
+
+    if(++mStrikes[culprit] >= FARM_RETRIES)
+    {
+      (*mResults)[culprit].mScore = OVERRUN_SCORE;
+      ++mDone;
+      ++mAbandoned;
+    }
+
+    else
+    {
+      mQueue.push_front(culprit);
+    }
+
+    for(size_t i : worker.mPending)
+      mQueue.push_back(i);
+    worker.mPending.clear();
+  }
+
+  Farm::Spawn(w);
+}
+
+//Will score genomes[i] as agent ids[i] of generation gen into results[i]
+void Farm::Evaluate(size_t gen, const std::vector<size_t> & ids, const std::vector<const PackedGenome *> & genomes,
+                    std::vector<Result> & results)
+{
+  mGen = gen;
+  mIds = &ids;
+  mGenomes = &genomes;
+  mResults = &results;
+
+  results.assign(ids.size(), Result());
+  mStrikes.assign(ids.size(), 0);
+  mQueue.clear();
+  for(size_t i = 0; i < ids.size(); ++i)
+    mQueue.push_back(i);
+
+  mDone = mRestarts = mAbandoned = 0;
+  std::vector<pollfd> polls;
+  std::vector<size_t> polled;
+
+  while(mDone < ids.size())
+  {
+    //Idle workers take the next batch
+    for(size_t w = 0; w < mWorkers.size(); ++w)
+    {
+      if(mWorkers[w].mFd < 0 && !Farm::Spawn(w))
+        continue;
+
+      if(mWorkers[w].mPending.empty() && !mQueue.empty() && !Farm::Send(w))
+        Farm::Fail(w);
+    }
+
+    polls.clear();
+    polled.clear();
+    for(size_t w = 0; w < mWorkers.size(); ++w)
+    {
+      if(mWorkers[w].mPending.empty())
+        continue;
+
+      polls.push_back({mWorkers[w].mFd, POLLIN, 0});
+      polled.push_back(w);
+    }
+
+    //Every worker is down and can not be forked again
+    bool alive = false;
+    for(Worker & worker : mWorkers)
+      alive = alive || worker.mFd >= 0;
+
+    if(polls.empty() && mQueue.empty())
+      continue;
+
+    if(!alive)
+    {
+      std::cout << "Farm has no workers left." << std::endl;
+      for(size_t i : mQueue)
+        results[i].mScore = OVERRUN_SCORE;
+      return;
+    }
+
+    int wait = FARM_TIMEOUT ? (int) std::min<size_t>(FARM_TIMEOUT, 1000) : -1;
+    if(poll(polls.data(), polls.size(), wait) < 0 && errno != EINTR)
+      break;
+
+    clock_t::time_point now = clock_t::now();
+    for(size_t k = 0; k < polls.size(); ++k)
+    {
+      size_t w = polled[k];
+
+      if(polls[k].revents && !Farm::Receive(w))
+      {
+        Farm::Fail(w);
+        continue;
+      }
+
+      auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(now - mWorkers[w].mLast).count();
+      if(FARM_TIMEOUT && !mWorkers[w].mPending.empty() && (size_t) idle >= FARM_TIMEOUT)
+        Farm::Fail(w);
+    }
+  }
+}
+
+//Will send a batch from the queue to worker w, false if it is gone
+bool Farm::Send(size_t w)
+{
+  Worker & worker = mWorkers[w];
+  std::vector<uint8_t> buf;
+  Put<uint32_t>(buf, mGen);
+  Put<uint32_t>(buf, 0);
+
+  uint32_t count = 0;
+  while(count < FARM_BATCH && !mQueue.empty())
+  {
+    size_t i = mQueue.front();
+    mQueue.pop_front();
+
+    const std::vector<uint8_t> & data = (*mGenomes)[i]->GetData();
+    Put<uint32_t>(buf, i);
+    Put<uint32_t>(buf, (*mIds)[i]);
+    Put<uint32_t>(buf, data.size());
+    buf.insert(buf.end(), data.begin(), data.end());
+
+    worker.mPending.push_back(i);
+    ++count;
+  }
+
+  std::memcpy(&buf[4], &count, 4);
+  worker.mLast = clock_t::now();
+  return Farm::WriteAll(worker.mFd, buf.data(), buf.size());
+}
+
+//Will read what worker w sent, false if it is gone
+bool Farm::Receive(size_t w)
+{
+  Worker & worker = mWorkers[w];
+  uint8_t buf[4096];
+
+  ssize_t n = read(worker.mFd, buf, sizeof(buf));
+  if(n <= 0)
+    return n < 0 && errno == EINTR;
+
+  worker.mIn.insert(worker.mIn.end(), buf, buf + n);
+  worker.mLast = clock_t::now();
+
+  size_t at = 0;
+  while(at + REPLY <= worker.mIn.size())
+  {
+    uint32_t i;
+    std::memcpy(&i, &worker.mIn[at], 4);
+
+    //Answers come back in the order sent
+    if(worker.mPending.empty() || worker.mPending.front() != i)
+      return false;
+
+    worker.mPending.pop_front();
+    std::memcpy(&(*mResults)[i], &worker.mIn[at + 4], sizeof(Result));
+    at += REPLY;
+    ++mDone;
+  }
+
+  worker.mIn.erase(worker.mIn.begin(), worker.mIn.begin() + at);
+  return true;
+}
+
+//Loop run by a worker, never returns
+void Farm::Work(int fd)
+{
+  std::vector<uint8_t> data;
+  PackedGenome genome;
+
+  while(true)
+  {
+    uint32_t gen, count;
+    if(!Farm::ReadAll(fd, &gen, 4) || !Farm::ReadAll(fd, &count, 4))
+      break;
+
+    for(uint32_t k = 0; k < count; ++k)
+    {
+      uint32_t head[3];
+      if(!Farm::ReadAll(fd, head, sizeof(head)))
+        _exit(1);
+
+      data.resize(head[2]);
+      if(!Farm::ReadAll(fd, data.data(), data.size()))
+        _exit(1);
+      genome.SetData(data.data(), data.size());
+
+      Result result;
+      mWork(gen, head[1], genome, result);
+
+      uint8_t reply[REPLY];
+      std::memcpy(reply, &head[0], 4);
+      std::memcpy(reply + 4, &result, sizeof(Result));
+      if(!Farm::WriteAll(fd, reply, REPLY))
+        _exit(1);
+    }
+  }
+
+  _exit(0);
+}
+
+//Loop run by the zygote, forks a worker per request, never returns
+//Ignoring SIGCHLD lets the kernel reap the workers
+void Farm::Zygote(int ctl)
+{
+  signal(SIGCHLD, SIG_IGN);
+
+  uint8_t request;
+  while(Farm::ReadAll(ctl, &request, 1))
+  {
+    int fds[2];
+    pid_t pid = -1;
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0)
+    {
+      pid = fork();
+
+      if(pid == 0)
+      {
+        //Only this worker's end stays open
+        close(ctl);
+        close(fds[0]);
+        Farm::Work(fds[1]);
+      }
+
+      close(fds[1]);
+      if(pid < 0)
+        close(fds[0]);
+    }
+
+    bool sent = Farm::SendFd(ctl, pid > 0 ? fds[0] : -1, pid);
+    if(pid > 0)
+      close(fds[0]);
+    if(!sent)
+      break;
+  }
+
+  _exit(0);
+}
+
+//Will pass fd and pid over sock, fd -1 passes only the pid
+bool Farm::SendFd(int sock, int fd, pid_t pid)
+{
+  iovec iov = {&pid, sizeof(pid)};
+  char control[CMSG_SPACE(sizeof(int))];
+  std::memset(control, 0, sizeof(control));
+
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  if(fd >= 0)
+  {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  ssize_t put;
+  do
+    put = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  while(put < 0 && errno == EINTR);
+
+  return put == (ssize_t) sizeof(pid);
+}
+
+//Will return the fd passed over sock, -1 if none came, and set pid
+int Farm::ReceiveFd(int sock, pid_t & pid)
+{
+  iovec iov = {&pid, sizeof(pid)};
+  char control[CMSG_SPACE(sizeof(int))];
+
+  msghdr msg;
+  std::memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t got;
+  do
+    got = recvmsg(sock, &msg, 0);
+  while(got < 0 && errno == EINTR);
+
+  if(got != (ssize_t) sizeof(pid))
+    return -1;
+
+  cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+  if(!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+    return -1;
+
+  int fd;
+  std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  return fd;
+}
+
+//Will read exactly n bytes, false on end of file or error
+bool Farm::ReadAll(int fd, void * buf, size_t n)
+{
+  uint8_t * at = (uint8_t *) buf;
+
+  while(n)
+  {
+    ssize_t got = read(fd, at, n);
+    if(got < 0 && errno == EINTR)
+      continue;
+    if(got <= 0)
+      return false;
+
+    at += got;
+    n -= got;
+  }
+
+  return true;
+}
+
+//Will write exactly n bytes, false if the other end is gone
+bool Farm::WriteAll(int fd, const void * buf, size_t n)
+{
+  const uint8_t * at = (const uint8_t *) buf;
+
+  while(n)
+  {
+    ssize_t put = send(fd, at, n, MSG_NOSIGNAL);
+    if(put < 0 && errno == EINTR)
+      continue;
+    if(put <= 0)
+      return false;
+
+    at += put;
+    n -= put;
+  }
+
+  return true;
+}
+
+#endif
@@ -2,9 +2,21 @@
 #define HP_GRAPH_H
 
 #include <iostream>
-#include <set>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
 
 #include "hp_config.h"
+#include "Topology.h"
+#include "Budget.h"
+#include "Traffic.h"
+#include "StreamRandom.h"
+#include "Permutation.h"
+#include "TimingWheel.h"
+#include "AllocStats.h"
+#include "Trace.h"
 #include "../../Empirical/source/tools/Random.h"
 #include "../../Empirical/source/tools/random_utils.h"
 #include "../../Empirical/source/hardware/EventDrivenGP.h"
@@ -15,16 +27,22 @@ struct Node;
 /* CONSTEXPR FOR HARDWARE */
 
 //Number of bits in the tag per hardware
-constexpr size_t TAG_WIDTH_ = 16; 
+//(HPConfig TAG_WIDTH must match, see main.cc)
+constexpr size_t TAG_WIDTH = 16;
+
+//Memory orders of the nodes, see Graph::Reorder
+enum NodeOrder : size_t {ORDER_ROW = 0, ORDER_BFS, ORDER_RCM, ORDER_HILBERT, NUM_ORDERS};
 
 /* NEW TYPE DECLARATIONS FOR HARDWARE*/
 
 //Type for a actural hardware
-using hardware_t = emp::EventDrivenGP_AW<TAG_WIDTH_>;
+using hardware_t = emp::EventDrivenGP_AW<TAG_WIDTH>;
 //Type for the hardware genome
 using program_t = hardware_t::Program;
+//Type for the hardwares state 
+using state_t = hardware_t::State;
 //Instruction object for hardware
-using ins_t = hardware_t::inst_t;
+using inst_t = hardware_t::inst_t;
 //Instruction library for hardware
 using inst_lib_t = hardware_t::inst_lib_t;
 //Type for Events for each hardware
@@ -35,6 +53,8 @@ using event_lib_t = hardware_t::event_lib_t;
 using function_t = hardware_t::Function;
 //Memory type for hardware
 using memory_t = hardware_t::memory_t;
+//Tag type for hardware
+using affinity_t = hardware_t::affinity_t;
 
 /* NEW TYPE DECLARATIONS FOR SIMPLICITY*/
 using graph_t = std::vector<std::vector<emp::Ptr< Node >>>;
@@ -42,44 +62,107 @@ using coor_t = std::pair<size_t, size_t>;
 using map_t = std::unordered_map<double, double>;
 using nodes_t = std::vector<emp::Ptr<Node>>;
 using randnum_t = std::vector<size_t>;
+//Takes mail for a node outside this graph's band, see Graph::SetBand
+using export_t = std::function<bool(size_t, size_t, const memory_t &, const affinity_t &)>;
+
+/* STRUCTS USED TO DELIVER BROADCASTS WITHOUT COPYING THEM */
+
+//One broadcast message, shared by every node that receives it
+struct Payload
+{
+  //Output memory of the sender
+  memory_t mMsg;
+  //Number of mailboxes still holding this payload
+  size_t mRefs = 0;
+};
+
+//Entry in a node mailbox
+struct Mail
+{
+  //Index of the payload in the graph pool
+  size_t mPayload;
+  //Tag of the event
+  affinity_t mAffinity;
+};
+
+//Mail still on an edge, see Graph::Send
+struct InFlight
+{
+  //Node it is headed for
+  size_t mX;
+  size_t mY;
+  //Index of the payload in the graph pool, held until the mail lands
+  size_t mPayload;
+  //Tag of the event
+  affinity_t mAffinity;
+};
 
 /* STRUCT USED TO IMITATE A NODE WITHIN THE SYSTEM */
 struct Node 
 {
   //Hardware within the node
   emp::Ptr<hardware_t> mHW;
-  //All of the nodes that this node has access too
-  std::set<coor_t> mFriends;
-
-  Node(emp::Ptr<inst_lib_t> ilib, emp::Ptr<event_lib_t> elib, emp::Ptr<emp::Random> rng)
+  //All of the nodes that this node has access too, sorted until churn rewires them
+  std::vector<coor_t> mFriends;
+  //Friends as CreateAdjList built them, restored by Graph::Reset
+  std::vector<coor_t> mBaseFriends;
+  //Work charged to this node since the last reset
+  size_t mInsts = 0;
+  size_t mCores = 0;
+  size_t mEvents = 0;
+  //Mail this node sent, and mail sent to it, since the last reset
+  Traffic mTraffic;
+  //Broadcasts waiting to be handled before the next SingleProcess
+  std::vector<Mail> mInbox;
+  //Position in Graph::mNodes
+  size_t mID = 0;
+  //Set while the node is in the active set
+  bool mActive = false;
+  //Set while the node runs the adversarial genome, its vote is not counted
+  bool mEnemy = false;
+  //Set while churn has the node down, it neither runs, gets mail nor votes
+  bool mDown = false;
+  //Position in Graph::mUp or Graph::mDown
+  size_t mSlot = 0;
+  //Random number generator of the hardware, reseeded on every reset
+  emp::Random mRng;
+
+  Node(emp::Ptr<inst_lib_t> ilib, emp::Ptr<event_lib_t> elib)
   {
-    mHW = emp::NewPtr<hardware_t>(ilib, elib, rng);
+    mHW = emp::NewPtr<hardware_t>(ilib, elib, &mRng);
   }
 };
 
 class Graph
 {
   public:
-    Graph(const HPConfig & config, emp::Ptr<emp::Random> rng = nullptr) :
-    GRA_DIM(config.GRA_DIM()), NUM_ITER(config.NUM_ITER()), 
+    //dim and iter override GRA_DIM and NUM_ITER when not 0
+    Graph(const HPConfig & config, size_t dim = 0, size_t iter = 0) :
+    GRA_DIM(dim ? dim : config.GRA_DIM()), NUM_ITER(iter ? iter : config.NUM_ITER()), 
     NUM_FRI(config.NUM_FRI()), NUM_ENE(config.NUM_ENE()),
-    mRng(rng), RNG_SEED(config.RNG_SEED()), MIN_BIN_THSH(config.MIN_BIN_THSH()),
+    mStream(config.RNG_SEED(), STREAM_GRAPH), RNG_SEED(config.RNG_SEED()), MIN_BIN_THSH(config.MIN_BIN_THSH()),
     UID(config.UID()), VOTE(config.VOTE()), POSX(config.POSX()), 
     POSY(config.POSY()), MAX_BND(config.MAX_BND()), MIN_BND(config.MIN_BND()),
-    MAX_CORES(config.MAX_CORES())
+    MAX_CORES(config.MAX_CORES()), NODE_ORDER(config.NODE_ORDER()), mBudget(config),
+    CHURN_START(config.CHURN_START()), CHURN_FAIL(config.CHURN_FAIL()),
+    CHURN_RECOVER(config.CHURN_RECOVER()), CHURN_REWIRE(config.CHURN_REWIRE()),
+    mChurn(CHURN_FAIL > 0.0 || CHURN_REWIRE > 0.0),
+    LATENCY_MIN(config.LATENCY_MIN()), LATENCY_MAX(std::max(config.LATENCY_MIN(), config.LATENCY_MAX())),
+    LATENCY_JITTER(config.LATENCY_JITTER()), DROP_RATE(config.DROP_RATE()),
+    mDelayed(LATENCY_MAX > 0 || LATENCY_JITTER > 0 || DROP_RATE > 0.0)
     {;}
 
+    //Will return if config asks for what this build can run, printing why not to os
+    static bool CheckConfig(const HPConfig & config, std::ostream & os = std::cout);
+
+    //Will return if [MIN_BND, MAX_BND) holds a UID for every node of a dim x dim grid
+    static bool CheckUIDs(const HPConfig & config, size_t dim, std::ostream & os = std::cout);
+
     //Delete all pointers in the class
     ~Graph()
     {
-      for(size_t i = 0; i < mGraph.size(); ++i)
-      {
-        for(size_t j = 0; j < mGraph[i].size(); ++j)
-        {
-          mGraph[i][j]->mHW.Delete();
-          mGraph[i][j].Delete();
-        }
-      }
+      for(Node & node : mStore)
+        node.mHW.Delete();
       
       mNodes.clear();
     }
@@ -89,15 +172,29 @@ class Graph
     //Give the graph NUM_ITER single processes to figure it out
     double RunGraph(size_t iter = -1);
 
+    //Will run every active node once, false if the budget was passed
+    bool RunIteration();
+
+    //Will recount the votes if one may have changed since the last count
+    void CountVotes();
+
+    //Will return if every node holds the same legal vote, which goes in vote
+    bool Unanimous(double & vote) const;
+
     //Function will create a general graph structure and set the x and y position per hardware
     void CreateGraph(size_t dim = 2, size_t type = 0, emp::Ptr<inst_lib_t> ilib = nullptr, emp::Ptr<event_lib_t> elib  = nullptr);
 
-    //Will create adjacency list for each node
+    //Will create adjacency list for each node, picking the topology from type
+    //Then lays the nodes out in memory as NODE_ORDER asks, see Graph::Reorder
     void CreateAdjList(size_t type = 0, size_t dim = 2);
 
+    //Will create adjacency list for each node with a fixed topology
+    template<typename TOPOLOGY>
+    void CreateAdjList(size_t dim);
+
     /* FUNCTIONS DEDICATED TO RUNNING EXPERIMENT */
 
-    //Will see if element exits in mRanNums vector
+    //Will see if me is the UID of a node of the whole grid
     bool Find(size_t me);
 
     //Will configure traits for hardware UID
@@ -117,6 +214,81 @@ class Graph
 
     //Will reset the graph to rerun with different program
     void Reset();
+
+    //Will pick the random stream of the next evaluation, call before Reset()
+    void SetStream(size_t gen, size_t agent, size_t trial = 0) {mStream.SetStream(gen, agent, trial);}
+
+    //Will return if the last run was stopped by the budget
+    bool IsOverrun() const {return mBudget.IsOverrun();}
+
+    //Will return how many legal votes were broadcast since the last reset
+    double GetVoteCount() const {return mVoteCount;}
+
+    //Will return how many broadcasts were lost on an edge since the last reset
+    size_t GetLost() const {return mLost;}
+
+    //Will return the mail of the whole graph since the last reset, see GetNode for one node
+    const Traffic & GetTraffic() const {return mTraffic;}
+
+    //Will return how many nodes this graph runs
+    size_t GetNodeCnt() const {return mNodes.size();}
+
+    //Will return the share of neighbor pairs at most window nodes apart in memory
+    double GetNearNeighbors(size_t window) const;
+
+
+    /* FUNCTIONS DEDICATED TO DELIVERING BROADCASTS */
+
+    //Will copy msg into a pooled payload that no mailbox holds yet
+    size_t OpenPayload(const memory_t & msg);
+
+    //Will put the payload on the edge from (fx, fy) to (x, y), false if over budget
+    bool Send(size_t fx, size_t fy, size_t x, size_t y, size_t payload, const affinity_t & affinity);
+
+    //Will put the payload into the mailbox of (x, y), false if over budget
+    bool Deliver(size_t x, size_t y, size_t payload, const affinity_t & affinity);
+
+    //Will put mail that came from another band into the mailbox of (x, y)
+    void Receive(size_t x, size_t y, const memory_t & msg, const affinity_t & affinity);
+
+    //Will give the payload back to the pool if no mailbox took it
+    void ClosePayload(size_t payload);
+
+    //Will spawn a core for every mail waiting on node
+    void DrainInbox(Node & node);
+
+    //Will send e from hw to all of its neighbors (BroadcastMail dispatch)
+    void Broadcast(hardware_t & hw, const event_t & e)
+    {
+      PhaseScope phase(PHASE_BROADCAST);
+      size_t x = hw.GetTrait(POSX), y = hw.GetTrait(POSY);
+      ++mGraph[x][y]->mTraffic.mBroadcasts;
+      ++mTraffic.mBroadcasts;
+      if(mTrace)
+        mTrace->Broadcast(Graph::GridID(hw));
+      (this->*mBroadcast)(x, y, e);
+    }
+
+    //Will count a legal vote being sent, then send e (BroadcastVote dispatch)
+    void BroadcastVote(hardware_t & hw, const event_t & e);
+
+    //Will spawn a core for an event queued on hw, if the budget allows it
+    void Handle_Broadcast(hardware_t & hw, const event_t & e);
+
+    //Will make RunGraph recount the votes after this iteration (SetVote)
+    void MarkVotes(hardware_t & hw)
+    {
+      mVotesDirty = true;
+      if(mTrace)
+        mTrace->Vote(Graph::GridID(hw), hw.GetTrait(VOTE));
+    }
+
+    //Will return the graph being run on this thread, used by the event library
+    static Graph *& Current()
+    {
+      static thread_local Graph * current = nullptr;
+      return current;
+    }
     
 
     /* FUNCTIONS DEDICATED TO PRINTING OUT CRAP */
@@ -158,11 +330,17 @@ class Graph
     randnum_t GetRandNums() const {return mRandomNums;}
 
     //Return a friends list of a node
-    std::set<coor_t> GetNodeNeig(size_t x, size_t y) const {return mGraph[x][y]->mFriends; }
+    const std::vector<coor_t> & GetNodeNeig(size_t x, size_t y) const {return mGraph[x][y]->mFriends; }
 
     //Will return a node
     Node* GetNode(size_t x, size_t y) {return mGraph[x][y];}
 
+    //Return the execution budget
+    Budget & GetBudget() {return mBudget;}
+
+    //Return the traffic of every evaluation since the last ClearReport()
+    TrafficReport & GetTrafficReport() {return mTrafficReport;}
+
 
     /* FUNCTIONS DEDICATED TO BE Setters */
 
@@ -174,6 +352,45 @@ class Graph
 
     //Load the dna into all the hardware
     void SetGenome(program_t & pro);
+
+    //Will give bad to count random nodes and good back to the last ones that had bad
+    //Call before Reset(), the positions come from the current stream
+    void SetEnemies(const program_t & bad, const program_t & good, size_t count);
+
+    //Will only build rows [begin, end) of the grid, call before CreateGraph
+    //Mail for rows outside the band goes to the export function
+    void SetBand(size_t begin, size_t end, export_t fun)
+    {
+      mRowBegin = begin;
+      mRowEnd = end;
+      mExport = fun;
+      //Bands draw churn apart, so it would not be the same graph
+      mChurn = false;
+    }
+
+    //Will record every evaluation from the next Reset() into trace, nullptr to stop
+    void SetTrace(emp::Ptr<Trace> trace) {mTrace = trace;}
+
+    //Will pick the memory order of the nodes, call before CreateAdjList, see NODE_ORDER
+    void SetOrder(size_t order) {NODE_ORDER = order;}
+    
+
+    /* FUNCTIONS DEDICATED TO CHURN */
+
+    //Will take node id down: its mail is dropped and its vote no longer counts
+    void FailNode(size_t id);
+
+    //Will bring node id back with fresh hardware and no vote
+    void RecoverNode(size_t id);
+
+    //Will add the edge between nodes a and b both ways, false if it is there already
+    bool AddEdge(size_t a, size_t b);
+
+    //Will remove the edge between nodes a and b both ways, false if it is not there
+    bool RemoveEdge(size_t a, size_t b);
+
+    //Will return how many nodes are down
+    size_t GetDownCnt() const {return mDown.size();}
     
 
     /* FUNCTIONS DEDICATED TO CLEAN UP CRAP */
@@ -184,14 +401,61 @@ class Graph
 
     //Holder of the graph object
     graph_t mGraph;
-    //Holder of random numbers generated
+    //UIDs of the nodes this graph builds, same order as mNodes
     randnum_t mRandomNums;
     //Will hold the same pointers as mGraph, but only to set traits
     nodes_t mNodes;
+    //Every node, in memory order, see Graph::Reorder
+    //Sized once and never grown, the hardware points at the generator of its node
+    std::vector<Node> mStore;
+    //Libraries the hardware was built with
+    emp::Ptr<inst_lib_t> mInstLib = nullptr;
+    emp::Ptr<event_lib_t> mEventLib = nullptr;
     //Will hold the final votes at time called upon
     map_t mFinalVotes;
     //The scheduler
     std::vector<coor_t> mSchedule;
+    //Nodes running the adversarial genome
+    std::vector<size_t> mEnemies;
+    //Position in the whole grid => UID - MIN_BND, for every band alike
+    KeyedPermutation mUIDs;
+    //Rows of the grid this graph builds, see SetBand
+    size_t mRowBegin = 0;
+    size_t mRowEnd = SIZE_MAX;
+    //Where mail for rows outside the band goes
+    export_t mExport;
+    //Recorder of the current evaluation, see SetTrace
+    emp::Ptr<Trace> mTrace = nullptr;
+
+    //Will return the position of hw over the full grid, as used in traces
+    size_t GridID(hardware_t & hw) {return (size_t) hw.GetTrait(POSX) * GRA_DIM + (size_t) hw.GetTrait(POSY);}
+
+    /* ACTIVE SET, SEE RunGraph */
+
+    //Will put node in the active set if it is not already there
+    void Wake(Node & node);
+
+    //Will return if node has nothing to do until it gets mail
+    bool IsIdle(Node & node) {return node.mInbox.empty() && node.mHW->GetActiveCores().empty() && node.mHW->GetPendingCores().empty();}
+
+    //Nodes to run next iteration
+    std::vector<size_t> mActive;
+    //Entry of the run queue, (key, node)
+    using run_t = std::pair<uint32_t, size_t>;
+
+    //Heap order of the run queue, smallest key on top
+    static bool Later(const run_t & a, const run_t & b) {return a > b;}
+
+    //Nodes left to run this iteration
+    std::vector<run_t> mRunQueue;
+    //Key of the node being run
+    uint32_t mCurKey = 0;
+    //Set while an iteration is being run
+    bool mRunning = false;
+    //Set when a vote may have changed since the last count
+    bool mVotesDirty = true;
+    //Consensus of the last count
+    double mConsensus = 0.0;
 
     /* GRAPH SPECIFIC PARAMATERS */
 
@@ -203,8 +467,8 @@ class Graph
     size_t NUM_FRI;
     //Number of enemies
     size_t NUM_ENE;
-    //Random number generator
-    emp::Ptr<emp::Random> mRng;
+    //Random stream of the current evaluation (UIDs, schedule, hardware seeds)
+    StreamRandom mStream;
     //Random Number seed
     size_t RNG_SEED;
     //Minimum threshold
@@ -226,138 +490,600 @@ class Graph
     size_t MIN_BND;
     //Max Cores
     size_t MAX_CORES;
+    //Memory order of the nodes
+    size_t NODE_ORDER;
+    //Execution budget for each evaluation
+    Budget mBudget;
+    //Pool of broadcast payloads, reused across evaluations
+    std::vector<Payload> mPayloads;
+    //Payloads in the pool that no mailbox holds
+    std::vector<size_t> mFreePayloads;
+    //Count of how many time broadcast vote is called with a legal vote
+    double mVoteCount = 0;
+    //Mail of the current evaluation, and of every evaluation since the last ClearReport()
+    Traffic mTraffic;
+    TrafficReport mTrafficReport;
+
+    /* NODE ORDER, SEE Graph::Reorder */
+
+    //Will rebuild the nodes in memory in the order NODE_ORDER picks
+    void Reorder();
+
+    //Will return every node id in breadth first order, by rising degree and reversed for RCM
+    std::vector<size_t> OrderBFS(bool rcm) const;
+
+    //Will return every node id in Hilbert curve order of its position
+    std::vector<size_t> OrderHilbert() const;
+
+    //Will return the distance along the Hilbert curve of (x, y) on an n x n grid, n a power of 2
+    static size_t Hilbert(size_t n, size_t x, size_t y);
+
+    //Will return the ids of the neighbors of node id in this band
+    void Neighbors(size_t id, std::vector<size_t> & out) const;
+
+    /* CHURN, SEE Graph::Churn */
+
+    //Will apply the failures, recoveries and rewirings of this iteration
+    void Churn();
+
+    //Will move node id to its other edge with a random live node
+    void Rewire(size_t id);
+
+    //Will return how many candidates to pass over before the next one hit with chance p
+    size_t Skip(double p);
+
+    //Will move id from list from to list to, keeping mSlot right
+    void MoveNode(size_t id, std::vector<size_t> & from, std::vector<size_t> & to);
+
+    //Will remove (x, y) from friends, false if it is not there
+    static bool DropFriend(std::vector<coor_t> & friends, const coor_t & pos);
+
+    //Will return the grid position of node id
+    coor_t PosOf(size_t id) {return {(size_t) mNodes[id]->mHW->GetTrait(POSX), (size_t) mNodes[id]->mHW->GetTrait(POSY)};}
+
+    //Iteration churn starts at
+    size_t CHURN_START;
+    //Chances per iteration
+    double CHURN_FAIL;
+    double CHURN_RECOVER;
+    double CHURN_REWIRE;
+    //Set when the graph changes while it runs
+    bool mChurn;
+    //Live and down nodes
+    std::vector<size_t> mUp;
+    std::vector<size_t> mDown;
+    //Down nodes whose vote would count
+    size_t mDownVoters = 0;
+    //Set once an edge moved since the last reset
+    bool mRewired = false;
+    //Iterations run since the last reset
+    size_t mIter = 0;
+    //Nodes picked this iteration
+    std::vector<size_t> mPicked;
+
+    /* NETWORK, SEE Graph::Send */
+
+    //Will deliver the mail due this iteration, false if over budget
+    bool Expire();
+
+    //Will hash the edge from node from to node to, both numbered over the full grid
+    uint64_t EdgeHash(size_t from, size_t to) const;
+
+    //Range of the latency of an edge, in iterations
+    size_t LATENCY_MIN;
+    size_t LATENCY_MAX;
+    //Most extra latency of one broadcast
+    size_t LATENCY_JITTER;
+    //Mean chance an edge loses a broadcast
+    double DROP_RATE;
+    //Set when broadcasts are not instant and reliable
+    bool mDelayed;
+    //Mail on its way, keyed by iteration
+    TimingWheel<InFlight> mWheel;
+    //Picks the latency and drop rate of every edge for this evaluation
+    uint64_t mEdgeSalt = 0;
+    //Broadcasts lost since the last reset
+    size_t mLost = 0;
+
+    /* BROADCAST DELIVERY, PICKED BY CreateAdjList */
+
+    //Will send e from (x, y) by walking its friends list
+    void BroadcastFriends(size_t x, size_t y, const event_t & e);
+
+    //Will send e from (x, y) computing neighbors from a fixed topology
+    template<typename TOPOLOGY>
+    void BroadcastTopology(size_t x, size_t y, const event_t & e);
+
+    //Delivery used by Broadcast()
+    void (Graph::*mBroadcast)(size_t, size_t, const event_t &) = &Graph::BroadcastFriends;
 };
 
+//Will return if config asks for what this build can run, printing why not to os
+//The hardware is compiled for one tag width and a fixed set of topologies
+bool Graph::CheckConfig(const HPConfig & config, std::ostream & os)
+{
+  if(config.TAG_WIDTH() != TAG_WIDTH)
+  {
+    os << "TAG_WIDTH " << config.TAG_WIDTH() << " is not compiled in, use " << TAG_WIDTH << std::endl;
+    return false;
+  }
+
+  if(config.GRA_TYPE() >= NUM_TOPOLOGIES)
+  {
+    os << "GRA_TYPE " << config.GRA_TYPE() << " is unknown, use 0 (torus) or 1 (moore)" << std::endl;
+    return false;
+  }
+
+  return Graph::CheckUIDs(config, config.GRA_DIM(), os) &&
+         Graph::CheckUIDs(config, config.SCREEN_DIM(), os);
+}
+
+//Will return if [MIN_BND, MAX_BND) holds a UID for every node of a dim x dim grid
+bool Graph::CheckUIDs(const HPConfig & config, size_t dim, std::ostream & os)
+{
+  size_t range = config.MAX_BND() > config.MIN_BND() ? config.MAX_BND() - config.MIN_BND() : 0;
+
+  if(dim * dim > range)
+  {
+    os << "A " << dim << "x" << dim << " graph needs " << dim * dim << " unique UIDs, MIN_BND "
+       << config.MIN_BND() << " to MAX_BND " << config.MAX_BND() << " only has " << range << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
 /* FUNCTIONS DEDICATED TO THE STRUCTURE */
 
 //Function will create a general graph structure and 
 //set the x and y position per hardware and wrong vote
 //and will spawn a core (0, memory_t(), false)
+//Nodes go into mStore in row major order, once per graph
 void Graph::CreateGraph(size_t dim, size_t type, emp::Ptr<inst_lib_t> ilib, emp::Ptr<event_lib_t> elib)
 {
-  //0 => Toroidal Graph
-  if(type == 0)
+  emp_assert(mStore.empty(), "CreateGraph builds a graph once.");
+  mInstLib = ilib;
+  mEventLib = elib;
+
+  //Every topology in Topology.h is laid out on a dim x dim grid
+  if(type < NUM_TOPOLOGIES)
   {
     mGraph.resize(dim);
+    mRowEnd = std::min(mRowEnd, dim);
+    mStore.reserve((mRowEnd - std::min(mRowBegin, mRowEnd)) * dim);
     
-    for(size_t i = 0; i < mGraph.size(); ++i)
+    for(size_t i = mRowBegin; i < mRowEnd; ++i)
     {
       for(size_t j = 0; j < dim; ++j)
       {
         mSchedule.emplace_back(std::make_pair(i,j));
 
-        emp::Ptr<Node> n =  emp::NewPtr<Node>(ilib, elib, mRng);
+        mStore.emplace_back(ilib, elib);
+        emp::Ptr<Node> n = &mStore.back();
         n->mHW->SetMinBindThresh(MIN_BIN_THSH);
         n->mHW->SetTrait(POSX, i);
         n->mHW->SetTrait(POSY, j);
-        n->mHW->SetMaxCores(100);
+        n->mHW->SetMaxCores(MAX_CORES);
+        n->mID = mNodes.size();
         mNodes.push_back(n);
         mGraph[i].push_back(n);
       }
     }
 
-    if(mNodes.size() != (GRA_DIM * GRA_DIM))
+    if(mNodes.size() != (mRowEnd - mRowBegin) * GRA_DIM)
     {
       std::cout << "WE NOT THE RIGHT SIZE" << std::endl;
     }
   }
 }
 
-//Will create adjacency list for each node
+//Will create adjacency list for each node, picking the topology from type
 void Graph::CreateAdjList(size_t type, size_t dim)
 {
-  //0 => Toroidal Graph
-  if(type == 0)
+  switch(type)
+  {
+    case TorusTopology::TYPE:
+      Graph::CreateAdjList<TorusTopology>(dim);
+      break;
+
+    case MooreTopology::TYPE:
+      Graph::CreateAdjList<MooreTopology>(dim);
+      break;
+
+    default:
+      std::cout << "Graph::CreateAdjList() unknown graph type " << type << std::endl;
+      break;
+  }
+
+  if(NODE_ORDER != ORDER_ROW)
+    Graph::Reorder();
+}
+
+//Will create adjacency list for each node with a fixed topology
+//Repeated neighbors are dropped when dim < TOPOLOGY::MIN_DIM, so small
+//graphs broadcast through the friends list instead, as do graphs with churn
+//Friends keep the order of TOPOLOGY::ForEachNeighbor, so both deliveries send
+//in the same order: Wake draws and budget breaks do not depend on which runs
+template<typename TOPOLOGY>
+void Graph::CreateAdjList(size_t dim)
+{
+  if(dim >= TOPOLOGY::MIN_DIM && !mChurn)
+    mBroadcast = &Graph::BroadcastTopology<TOPOLOGY>;
+  else
+    mBroadcast = &Graph::BroadcastFriends;
+
+  for(size_t i = 0; i < mGraph.size(); ++i)
   {
-    for(size_t i = 0; i < mGraph.size(); ++i)
+    for(size_t j = 0; j < mGraph[i].size(); ++j)
     {
-      for(size_t j = 0; j < mGraph[i].size(); ++j)
+      auto & friends = mGraph[i][j]->mFriends;
+      TOPOLOGY::ForEachNeighbor(i, j, dim, [&friends](size_t x, size_t y)
       {
-        //Right
-        mGraph[i][j]->mFriends.emplace(std::make_pair((((i+dim)+1) % dim), j));
-        //Left
-        mGraph[i][j]->mFriends.emplace(std::make_pair((((i+dim)-1) % dim), j));
-        //Up
-        mGraph[i][j]->mFriends.emplace(std::make_pair(i, (((j+dim)+1) % dim)));
-        //Down
-        mGraph[i][j]->mFriends.emplace(std::make_pair(i, (((j+dim)-1) % dim)));
+        //Only the first of a repeated neighbor is kept
+        if(std::find(friends.begin(), friends.end(), coor_t(x, y)) == friends.end())
+          friends.emplace_back(x, y);
+        return true;
+      });
+
+      mGraph[i][j]->mBaseFriends = friends;
+    }
+  }
+}
+
+/* FUNCTIONS DEDICATED TO NODE ORDER */
+
+//Will rebuild the nodes in memory in the order NODE_ORDER picks
+//Broadcasts touch the mailbox of every neighbor, so neighbors that sit close
+//in memory share cache lines and pages. Only the placement changes: ids,
+//positions, traits and friends stay, so runs give the same results in any order.
+//Fresh nodes and hardware are built in the new order, the old ones are freed.
+//On the torus and Moore grids only Hilbert order puts more neighbors close
+//than row major does; BFS and RCM spread them out (see Batch near_neighbors).
+void Graph::Reorder()
+{
+  std::vector<size_t> order;
+
+  switch(NODE_ORDER)
+  {
+    case ORDER_BFS:
+      order = Graph::OrderBFS(false);
+      break;
+
+    case ORDER_RCM:
+      order = Graph::OrderBFS(true);
+      break;
+
+    case ORDER_HILBERT:
+      order = Graph::OrderHilbert();
+      break;
+
+    default:
+      std::cout << "Graph::Reorder() unknown node order " << NODE_ORDER << std::endl;
+      return;
+  }
+
+  std::vector<Node> store;
+  store.reserve(mStore.size());
+
+  for(size_t id : order)
+  {
+    Node & old = *mNodes[id];
+    store.emplace_back(mInstLib, mEventLib);
+    Node & n = store.back();
+
+    n.mHW->SetMinBindThresh(MIN_BIN_THSH);
+    n.mHW->SetMaxCores(MAX_CORES);
+    for(size_t trait : {(size_t) UID, VOTE, POSX, POSY})
+      n.mHW->SetTrait(trait, old.mHW->GetTrait(trait));
+
+    n.mID = id;
+    n.mFriends.swap(old.mFriends);
+    n.mBaseFriends.swap(old.mBaseFriends);
+  }
+
+  for(Node & node : mStore)
+    node.mHW.Delete();
+  mStore.swap(store);
+
+  for(Node & node : mStore)
+  {
+    mNodes[node.mID] = &node;
+    mGraph[(size_t) node.mHW->GetTrait(POSX)][(size_t) node.mHW->GetTrait(POSY)] = &node;
+  }
+}
+
+//Will return every node id in breadth first order, by rising degree and reversed for RCM
+//Each component starts from its first node, or for RCM from its lowest degree node
+std::vector<size_t> Graph::OrderBFS(bool rcm) const
+{
+  size_t n = mNodes.size();
+  std::vector<size_t> order, degree(n), kids;
+  std::vector<bool> seen(n, false);
+  order.reserve(n);
+
+  for(size_t id = 0; id < n; ++id)
+  {
+    Graph::Neighbors(id, kids);
+    degree[id] = kids.size();
+  }
+
+  for(size_t next = 0; order.size() < n; )
+  {
+    while(seen[next])
+      ++next;
+
+    size_t start = next;
+    for(size_t id = next; rcm && id < n; ++id)
+    {
+      if(!seen[id] && degree[id] < degree[start])
+        start = id;
+    }
+
+    seen[start] = true;
+    order.push_back(start);
+
+    for(size_t head = order.size() - 1; head < order.size(); ++head)
+    {
+      size_t first = order.size();
+      Graph::Neighbors(order[head], kids);
+
+      for(size_t k : kids)
+      {
+        if(!seen[k])
+        {
+          seen[k] = true;
+          order.push_back(k);
+        }
+      }
+
+      if(rcm)
+      {
+        std::stable_sort(order.begin() + first, order.end(), [&degree](size_t a, size_t b)
+        {
+          return degree[a] < degree[b];
+        });
+      }
+    }
+  }
+
+  if(rcm)
+    std::reverse(order.begin(), order.end());
+
+  return order;
+}
+
+//Will return every node id in Hilbert curve order of its position
+//The curve covers the smallest power of 2 grid holding GRA_DIM x GRA_DIM
+std::vector<size_t> Graph::OrderHilbert() const
+{
+  size_t side = 1;
+  while(side < GRA_DIM)
+    side <<= 1;
+
+  std::vector<std::pair<size_t, size_t>> keys;
+  keys.reserve(mNodes.size());
+  for(size_t id = 0; id < mNodes.size(); ++id)
+  {
+    size_t x = mNodes[id]->mHW->GetTrait(POSX), y = mNodes[id]->mHW->GetTrait(POSY);
+    keys.emplace_back(Graph::Hilbert(side, x, y), id);
+  }
+
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<size_t> order;
+  order.reserve(keys.size());
+  for(auto & key : keys)
+    order.push_back(key.second);
+
+  return order;
+}
+
+//Will return the distance along the Hilbert curve of (x, y) on an n x n grid, n a power of 2
+size_t Graph::Hilbert(size_t n, size_t x, size_t y)
+{
+  size_t d = 0;
+
+  for(size_t s = n / 2; s > 0; s /= 2)
+  {
+    size_t rx = (x & s) > 0;
+    size_t ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+
+    //Rotate the quadrant so the curve inside it starts where the last one ended
+    if(ry == 0)
+    {
+      if(rx == 1)
+      {
+        x = n - 1 - x;
+        y = n - 1 - y;
       }
+      std::swap(x, y);
     }
   }
+
+  return d;
+}
+
+//Will return the share of neighbor pairs at most window nodes apart in memory
+//Counts every edge of the built topology once per direction, churn is ignored.
+//Unlike cache misses this needs no perf counter, so it can always be compared
+double Graph::GetNearNeighbors(size_t window) const
+{
+  std::vector<size_t> kids;
+  size_t edges = 0, near = 0;
+
+  for(size_t id = 0; id < mNodes.size(); ++id)
+  {
+    Graph::Neighbors(id, kids);
+    for(size_t k : kids)
+    {
+      const Node * a = mNodes[id].Raw();
+      const Node * b = mNodes[k].Raw();
+      near += (size_t) (a < b ? b - a : a - b) <= window;
+      ++edges;
+    }
+  }
+
+  return edges ? (double) near / edges : 0.0;
+}
+
+//Will return the ids of the neighbors of node id in this band
+void Graph::Neighbors(size_t id, std::vector<size_t> & out) const
+{
+  out.clear();
+
+  for(const coor_t & pos : mNodes[id]->mBaseFriends)
+  {
+    if(pos.first >= mRowBegin && pos.first < mRowEnd)
+      out.push_back(mGraph[pos.first][pos.second]->mID);
+  }
 }
 
 /* FUNCTIONS DEDICATED TO RUNNING EXPERIMENT */
 
 //Give the graph NUM_ITER single processes to figure it out
+//Returns OVERRUN_SCORE as soon as the budget is passed
+//Only nodes in the active set are run: a node with no cores and no mail does
+//nothing in SingleProcess, so skipping it changes nothing but the cost
 double Graph::RunGraph(size_t iter)
 {
   if(iter == -1)
     iter = NUM_ITER;
 
   double score = 0.0;
+  mVotesDirty = true;
 
   for(size_t i = 0; i < iter; ++i)
   {
-    emp::Shuffle(*mRng, mSchedule);
-
-    for(auto p : mSchedule)
+    if(!Graph::RunIteration())
     {
-      mGraph[p.first][p.second]->mHW->SingleProcess();
+      mTrafficReport.Add(mTraffic);
+      return mBudget.OVERRUN_SCORE;
     }
-    Graph::MakeFinalVotes();
-    score += Graph::Consensus();
+
+    Graph::CountVotes();
+    score += mConsensus;
   }
 
+  mTrafficReport.Add(mTraffic);
   Graph::MakeFinalVotes();
   score += Graph::LegalVotes();
   score += Graph::LargestLegalVotes();  
   return score;
 }
 
-//Will see if element exits in vector
-//True if inside mRandomNums
-//False if not
-bool Graph::Find(size_t me)
+//Will run every active node once, false if the budget was passed
+bool Graph::RunIteration()
 {
-  for(auto num : mRandomNums)
-  {
-    if(num == me)
-      return true;
-  }
+  Graph::Current() = this;
 
-  return false;
-}
+  if(mTrace)
+    mTrace->Iteration();
 
-//Will configure traits for hardware UID
-void Graph::ConfigureTraits()
-{
-  mRandomNums.clear();
+  if(mChurn)
+    Graph::Churn();
 
-  while(mRandomNums.size() != (GRA_DIM * GRA_DIM))
+  //Mail landing now wakes its node before the shuffle
+  if(mDelayed && !Graph::Expire())
+    return false;
+
+  //Random keys in increasing order are a uniform shuffle of the active nodes
+  mRunQueue.clear();
+  for(size_t id : mActive)
+  {
+    mRunQueue.emplace_back(mStream.GetUInt32(), id);
+  }
+  mActive.clear();
+  std::make_heap(mRunQueue.begin(), mRunQueue.end(), Graph::Later);
+  mRunning = true;
+
+  while(!mRunQueue.empty())
   {
-    size_t num = mRng->GetUInt(MIN_BND, MAX_BND);
+    std::pop_heap(mRunQueue.begin(), mRunQueue.end(), Graph::Later);
+    mCurKey = mRunQueue.back().first;
+    auto node = mNodes[mRunQueue.back().second];
+    mRunQueue.pop_back();
 
-    if(Graph::Find(num))
+    //Went down after it was queued
+    if(node->mDown)
     {
+      node->mActive = false;
       continue;
     }
 
+    Graph::DrainInbox(*node);
+
+    //Every active core runs one instruction
+    mBudget.SpendInsts(node->mInsts, node->mHW->GetActiveCores().size());
+    if(mBudget.IsOverrun())
+      return false;
+
+    node->mHW->SingleProcess();
+    if(mBudget.IsOverrun())
+      return false;
+
+    if(Graph::IsIdle(*node))
+      node->mActive = false;
     else
-    {
-      mRandomNums.push_back(num);
-    }
+      mActive.push_back(node->mID);
+  }
+
+  mRunning = false;
+  return true;
+}
+
+//Will recount the votes if one may have changed since the last count
+//Votes only move through SetVote, so quiet iterations keep the last count
+void Graph::CountVotes()
+{
+  if(mVotesDirty)
+  {
+    Graph::MakeFinalVotes();
+    mConsensus = Graph::Consensus();
+    mVotesDirty = false;
   }
-  
-  if(mRandomNums.size() != mNodes.size())
+}
+
+//Will return if every node holds the same legal vote, which goes in vote
+bool Graph::Unanimous(double & vote) const
+{
+  if(mFinalVotes.size() != 1 || mFinalVotes.begin()->second != mNodes.size() - mEnemies.size() - mDownVoters)
+    return false;
+
+  vote = mFinalVotes.begin()->first;
+  return true;
+}
+
+//Will see if me is the UID of a node of the whole grid
+//True if the permutation puts it at a grid position
+//False if not
+bool Graph::Find(size_t me)
+{
+  if(me < MIN_BND || me - MIN_BND >= mUIDs.GetSize())
+    return false;
+
+  return mUIDs.Inverse(me - MIN_BND) < GRA_DIM * GRA_DIM;
+}
+
+//Will configure traits for hardware UID
+//Node i of the whole grid gets MIN_BND + mUIDs.Forward(i). Every band draws
+//the same keys, so they agree on the UIDs without listing the whole grid
+void Graph::ConfigureTraits()
+{
+  if(GRA_DIM * GRA_DIM > (MAX_BND > MIN_BND ? MAX_BND - MIN_BND : 0))
   {
-    std::cout << "Graph::ConfigureTraits() vector sizes not equal!" << std::endl;
-    std::cout << "RandomNums: " << mRandomNums.size() << " mNodes: " << mNodes.size() << std::endl;
+    std::cout << "Graph::ConfigureTraits() not enough UIDs, see Graph::CheckUIDs" << std::endl;
     exit(0);
   }
 
-  for(size_t i = 0; i < mRandomNums.size(); ++i)
+  mUIDs.Reset(MAX_BND - MIN_BND, mStream);
+  mRandomNums.clear();
+
+  size_t first = mRowBegin * GRA_DIM;
+  for(size_t i = 0; i < mNodes.size(); ++i)
   {
-    mNodes[i]->mHW->SetTrait(UID, mRandomNums[i]);
+    mRandomNums.push_back(MIN_BND + mUIDs.Forward(first + i));
+    mNodes[i]->mHW->SetTrait(UID, mRandomNums.back());
     mNodes[i]->mHW->SetTrait(VOTE, -999);
   }
 }
@@ -369,6 +1095,9 @@ void Graph::MakeFinalVotes()
 
   for(size_t i = 0; i < mNodes.size(); ++i)
   {
+    if(mNodes[i]->mEnemy || mNodes[i]->mDown)
+      continue;
+
     double vote = mNodes[i]->mHW->GetTrait(VOTE);
 
     if(Graph::Find(vote))
@@ -431,7 +1160,8 @@ double Graph::Consensus()
     }
   }
 
-  if(size == (GRA_DIM * GRA_DIM))
+  //Only live nodes have to agree, but at least one has to
+  if(size > 0 && size == (GRA_DIM * GRA_DIM) - mEnemies.size() - mDownVoters)
   {
     return (double) (GRA_DIM * GRA_DIM);
   }
@@ -445,15 +1175,480 @@ double Graph::Consensus()
 //Will reset the graph to rerun with different program
 void Graph::Reset()
 {
+  PhaseScope phase(PHASE_RESET);
   mRandomNums.clear();
   mFinalVotes.clear();
+  mBudget.Reset();
+  mVoteCount = 0;
+  mTraffic.Clear();
   Graph::ConfigureTraits();
 
+  //Drawn before the band seeds are skipped, so every band gets the same salt
+  mWheel.Clear();
+  mLost = 0;
+  if(mDelayed)
+  {
+    mEdgeSalt = ((uint64_t) mStream.GetUInt32() << 32) | mStream.GetUInt32();
+  }
+
+  mFreePayloads.clear();
+  for(size_t i = 0; i < mPayloads.size(); ++i)
+  {
+    mPayloads[i].mRefs = 0;
+    mFreePayloads.push_back(i);
+  }
+
+  //Skip the seeds of rows before the band, so every node gets the seed it has in the full grid
+  for(size_t i = 0; i < mRowBegin * GRA_DIM; ++i)
+  {
+    mStream.GetSeed();
+  }
+
   for(size_t i = 0; i < mNodes.size(); ++i)
   {
+    mNodes[i]->mInsts = mNodes[i]->mCores = mNodes[i]->mEvents = 0;
+    mNodes[i]->mTraffic.Clear();
+    mNodes[i]->mInbox.clear();
+    mNodes[i]->mRng.ResetSeed(mStream.GetSeed());
     mNodes[i]->mHW->ResetHardware();
     mNodes[i]->mHW->SpawnCore(0, memory_t(), true);
   }
+
+  //Every node starts with its main core
+  mRunQueue.clear();
+  mActive.clear();
+  mRunning = false;
+  for(size_t i = 0; i < mNodes.size(); ++i)
+  {
+    mNodes[i]->mActive = true;
+    mActive.push_back(i);
+  }
+
+  //Every node is up again, on the edges CreateAdjList built
+  mUp.clear();
+  mDown.clear();
+  mDownVoters = 0;
+  mIter = 0;
+  for(size_t i = 0; i < mNodes.size(); ++i)
+  {
+    mNodes[i]->mDown = false;
+    mNodes[i]->mSlot = i;
+    mUp.push_back(i);
+
+    if(mRewired)
+      mNodes[i]->mFriends = mNodes[i]->mBaseFriends;
+  }
+  mRewired = false;
+
+  if(mTrace)
+    mTrace->Start(GRA_DIM, mRandomNums);
+}
+
+
+/* FUNCTIONS DEDICATED TO DELIVERING BROADCASTS */
+
+//Will copy msg into a pooled payload that no mailbox holds yet
+//Copy assignment reuses the map nodes of the recycled payload
+size_t Graph::OpenPayload(const memory_t & msg)
+{
+  if(mFreePayloads.empty())
+  {
+    mFreePayloads.push_back(mPayloads.size());
+    mPayloads.emplace_back();
+  }
+
+  size_t id = mFreePayloads.back();
+  mFreePayloads.pop_back();
+  mPayloads[id].mMsg = msg;
+  mPayloads[id].mRefs = 0;
+  return id;
+}
+
+//Will put the payload on the edge from (fx, fy) to (x, y), false if over budget
+//An edge drops a broadcast with its own rate in [0, 2 * DROP_RATE] and holds
+//it for its own latency in [LATENCY_MIN, LATENCY_MAX] plus up to
+//LATENCY_JITTER; mail held in mWheel keeps a reference to its payload
+bool Graph::Send(size_t fx, size_t fy, size_t x, size_t y, size_t payload, const affinity_t & affinity)
+{
+  Traffic & from = mGraph[fx][fy]->mTraffic;
+  size_t entries = mPayloads[payload].mMsg.size();
+  ++from.mSent;
+  ++mTraffic.mSent;
+  from.mPayload += entries;
+  mTraffic.mPayload += entries;
+
+  if(!mDelayed)
+    return Graph::Deliver(x, y, payload, affinity);
+
+  uint64_t h = Graph::EdgeHash(fx * GRA_DIM + fy, x * GRA_DIM + y);
+
+  if(DROP_RATE > 0.0 && mStream.GetDouble() < 2.0 * DROP_RATE * (h >> 32) / 4294967296.0)
+  {
+    ++mLost;
+    ++mTraffic.mDropped;
+    if(x >= mRowBegin && x < mRowEnd)
+      ++mGraph[x][y]->mTraffic.mDropped;
+    return true;
+  }
+
+  size_t delay = LATENCY_MIN + (h & 0xFFFFFFFF) % (LATENCY_MAX - LATENCY_MIN + 1);
+  if(LATENCY_JITTER)
+    delay += mStream.GetUInt(LATENCY_JITTER + 1);
+
+  if(delay == 0)
+    return Graph::Deliver(x, y, payload, affinity);
+
+  mPayloads[payload].mRefs += 1;
+  mWheel.Insert(delay, InFlight{x, y, payload, affinity});
+  return true;
+}
+
+//Will put the payload into the mailbox of (x, y), false if over budget
+bool Graph::Deliver(size_t x, size_t y, size_t payload, const affinity_t & affinity)
+{
+  if(x < mRowBegin || x >= mRowEnd)
+    return mExport && mExport(x, y, mPayloads[payload].mMsg, affinity);
+
+  auto node = mGraph[x][y];
+
+  //Lost on a down node, or past the event budget
+  if(node->mDown || !mBudget.SpendEvent(node->mEvents))
+  {
+    ++node->mTraffic.mDropped;
+    ++mTraffic.mDropped;
+    return node->mDown;
+  }
+
+  node->mInbox.push_back({payload, affinity});
+  mPayloads[payload].mRefs += 1;
+  ++node->mTraffic.mDelivered;
+  ++mTraffic.mDelivered;
+  node->mTraffic.mInboxPeak = std::max(node->mTraffic.mInboxPeak, node->mInbox.size());
+  mTraffic.mInboxPeak = std::max(mTraffic.mInboxPeak, node->mInbox.size());
+  Graph::Wake(*node);
+  return true;
+}
+
+//Will put node in the active set if it is not already there
+//A node woken mid iteration draws its key now; if the key is past the node
+//being run it still runs this iteration, exactly as it would have in a full
+//shuffle of every node
+void Graph::Wake(Node & node)
+{
+  if(node.mActive || node.mDown)
+    return;
+
+  node.mActive = true;
+
+  if(mRunning)
+  {
+    uint32_t key = mStream.GetUInt32();
+
+    if(key > mCurKey)
+    {
+      mRunQueue.emplace_back(key, node.mID);
+      std::push_heap(mRunQueue.begin(), mRunQueue.end(), Graph::Later);
+      return;
+    }
+  }
+
+  mActive.push_back(node.mID);
+}
+
+//Will put mail that came from another band into the mailbox of (x, y)
+void Graph::Receive(size_t x, size_t y, const memory_t & msg, const affinity_t & affinity)
+{
+  size_t payload = Graph::OpenPayload(msg);
+  Graph::Deliver(x, y, payload, affinity);
+  Graph::ClosePayload(payload);
+}
+
+//Will give the payload back to the pool if no mailbox took it
+void Graph::ClosePayload(size_t payload)
+{
+  if(mPayloads[payload].mRefs == 0)
+    mFreePayloads.push_back(payload);
+}
+
+//Will deliver the mail due this iteration, false if over budget
+//Past the budget the rest of the mail is only let go of
+bool Graph::Expire()
+{
+  bool ok = true;
+
+  mWheel.Advance([this, &ok](const InFlight & mail)
+  {
+    if(ok)
+      ok = this->Deliver(mail.mX, mail.mY, mail.mPayload, mail.mAffinity);
+
+    Payload & p = mPayloads[mail.mPayload];
+    p.mRefs -= 1;
+    if(p.mRefs == 0)
+      mFreePayloads.push_back(mail.mPayload);
+  });
+
+  return ok;
+}
+
+//Will hash the edge from node from to node to, both numbered over the full grid
+//SplitMix64 finalizer, the high half picks the drop rate and the low half the latency
+uint64_t Graph::EdgeHash(size_t from, size_t to) const
+{
+  uint64_t z = mEdgeSalt + (from * GRA_DIM * GRA_DIM + to + 1) * 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+//Will spawn a core for every mail waiting on node
+//Same as the hardware handling queued BroadcastMail events first thing in SingleProcess
+void Graph::DrainInbox(Node & node)
+{
+  size_t spawned = 0;
+
+  for(const Mail & mail : node.mInbox)
+  {
+    Payload & p = mPayloads[mail.mPayload];
+
+    if(mBudget.SpendCore(node.mCores))
+    {
+      node.mHW->SpawnCore(mail.mAffinity, node.mHW->GetMinBindThresh(), p.mMsg);
+      ++spawned;
+    }
+
+    p.mRefs -= 1;
+    if(p.mRefs == 0)
+      mFreePayloads.push_back(mail.mPayload);
+  }
+
+  node.mInbox.clear();
+  node.mTraffic.mSpawned += spawned;
+  mTraffic.mSpawned += spawned;
+
+  if(mTrace && spawned)
+    mTrace->Spawn(Graph::GridID(*node.mHW), spawned);
+}
+
+//Will count a legal vote being sent, then send e (BroadcastVote dispatch)
+void Graph::BroadcastVote(hardware_t & hw, const event_t & e)
+{
+  double vote = hw.GetTrait(VOTE);
+
+  if(Graph::Find(vote) && !mGraph[hw.GetTrait(POSX)][hw.GetTrait(POSY)]->mEnemy)
+  {
+    mVoteCount += 1;
+  }
+
+  Graph::Broadcast(hw, e);
+}
+
+//Will spawn a core for an event queued on hw, if the budget allows it
+void Graph::Handle_Broadcast(hardware_t & hw, const event_t & e)
+{
+  auto node = mGraph[hw.GetTrait(POSX)][hw.GetTrait(POSY)];
+
+  if(mBudget.SpendCore(node->mCores))
+  {
+    hw.SpawnCore(e.affinity, hw.GetMinBindThresh(), e.msg);
+    ++node->mTraffic.mSpawned;
+    ++mTraffic.mSpawned;
+    if(mTrace)
+      mTrace->Spawn(Graph::GridID(hw), 1);
+  }
+}
+
+//Will send e from (x, y) by walking its friends list
+//Every neighbor gets the same pooled payload, see Graph::OpenPayload
+void Graph::BroadcastFriends(size_t x, size_t y, const event_t & e)
+{
+  size_t payload = Graph::OpenPayload(e.msg);
+
+  for(auto pair : mGraph[x][y]->mFriends)
+  {
+    if(!Graph::Send(x, y, pair.first, pair.second, payload, e.affinity))
+      break;
+  }
+
+  Graph::ClosePayload(payload);
+}
+
+//Will send e from (x, y) computing neighbors from a fixed topology
+//Stops at the first Send over budget, like Graph::BroadcastFriends
+template<typename TOPOLOGY>
+void Graph::BroadcastTopology(size_t x, size_t y, const event_t & e)
+{
+  size_t payload = Graph::OpenPayload(e.msg);
+
+  TOPOLOGY::ForEachNeighbor(x, y, GRA_DIM, [this, x, y, payload, &e](size_t i, size_t j)
+  {
+    return this->Send(x, y, i, j, payload, e.affinity);
+  });
+
+  Graph::ClosePayload(payload);
+}
+
+
+/* FUNCTIONS DEDICATED TO CHURN */
+
+//Will apply the failures, recoveries and rewirings of this iteration
+//Each list is walked with geometric skips, so an iteration costs the number
+//of changes, each O(degree), not the number of nodes. Recoveries go first,
+//so no node goes down and comes back in the same iteration
+void Graph::Churn()
+{
+  if(mIter++ < CHURN_START)
+    return;
+
+  mPicked.clear();
+  for(size_t k = Graph::Skip(CHURN_RECOVER); k < mDown.size(); k += 1 + Graph::Skip(CHURN_RECOVER))
+    mPicked.push_back(mDown[k]);
+  for(size_t id : mPicked)
+    Graph::RecoverNode(id);
+
+  mPicked.clear();
+  for(size_t k = Graph::Skip(CHURN_FAIL); k < mUp.size(); k += 1 + Graph::Skip(CHURN_FAIL))
+    mPicked.push_back(mUp[k]);
+  for(size_t id : mPicked)
+    Graph::FailNode(id);
+
+  mPicked.clear();
+  for(size_t k = Graph::Skip(CHURN_REWIRE); k < mUp.size(); k += 1 + Graph::Skip(CHURN_REWIRE))
+    mPicked.push_back(mUp[k]);
+  for(size_t id : mPicked)
+    Graph::Rewire(id);
+}
+
+//Will take node id down: its mail is dropped and its vote no longer counts
+//Its neighbors keep their edges to it, mail sent there is lost in Deliver
+void Graph::FailNode(size_t id)
+{
+  Node & node = *mNodes[id];
+  if(node.mDown)
+    return;
+
+  node.mDown = true;
+  Graph::MoveNode(id, mUp, mDown);
+
+  for(const Mail & mail : node.mInbox)
+  {
+    Payload & p = mPayloads[mail.mPayload];
+    p.mRefs -= 1;
+    if(p.mRefs == 0)
+      mFreePayloads.push_back(mail.mPayload);
+  }
+  node.mTraffic.mDropped += node.mInbox.size();
+  mTraffic.mDropped += node.mInbox.size();
+  node.mInbox.clear();
+
+  if(!node.mEnemy)
+    ++mDownVoters;
+  mVotesDirty = true;
+}
+
+//Will bring node id back with fresh hardware and no vote
+void Graph::RecoverNode(size_t id)
+{
+  Node & node = *mNodes[id];
+  if(!node.mDown)
+    return;
+
+  node.mDown = false;
+  Graph::MoveNode(id, mDown, mUp);
+
+  if(!node.mEnemy)
+    --mDownVoters;
+  mVotesDirty = true;
+
+  node.mHW->SetTrait(VOTE, -999);
+  node.mHW->ResetHardware();
+  node.mHW->SpawnCore(0, memory_t(), true);
+  if(mTrace)
+    mTrace->Vote(Graph::GridID(*node.mHW), -999);
+
+  Graph::Wake(node);
+}
+
+//Will move node id to its other edge with a random live node
+//Nothing changes if that node is id itself or already a neighbor
+void Graph::Rewire(size_t id)
+{
+  std::vector<coor_t> & friends = mNodes[id]->mFriends;
+  if(friends.empty())
+    return;
+
+  coor_t old = friends[mStream.GetUInt(friends.size())];
+  size_t to = mUp[mStream.GetUInt(mUp.size())];
+  coor_t pos = Graph::PosOf(to);
+
+  if(to == id || std::find(friends.begin(), friends.end(), pos) != friends.end())
+    return;
+
+  Graph::RemoveEdge(id, mGraph[old.first][old.second]->mID);
+  Graph::AddEdge(id, to);
+}
+
+//Will add the edge between nodes a and b both ways, false if it is there already
+bool Graph::AddEdge(size_t a, size_t b)
+{
+  coor_t pa = Graph::PosOf(a), pb = Graph::PosOf(b);
+  std::vector<coor_t> & fa = mNodes[a]->mFriends;
+
+  if(a == b || std::find(fa.begin(), fa.end(), pb) != fa.end())
+    return false;
+
+  fa.push_back(pb);
+  mNodes[b]->mFriends.push_back(pa);
+  mRewired = true;
+  return true;
+}
+
+//Will remove the edge between nodes a and b both ways, false if it is not there
+bool Graph::RemoveEdge(size_t a, size_t b)
+{
+  if(!Graph::DropFriend(mNodes[a]->mFriends, Graph::PosOf(b)))
+    return false;
+
+  Graph::DropFriend(mNodes[b]->mFriends, Graph::PosOf(a));
+  mRewired = true;
+  return true;
+}
+
+//Will remove pos from friends, false if it is not there
+//Swaps the last friend into its place, so the list leaves topology order
+bool Graph::DropFriend(std::vector<coor_t> & friends, const coor_t & pos)
+{
+  auto it = std::find(friends.begin(), friends.end(), pos);
+  if(it == friends.end())
+    return false;
+
+  *it = friends.back();
+  friends.pop_back();
+  return true;
+}
+
+//Will return how many candidates to pass over before the next one hit with chance p
+//Geometric with P(k) = (1 - p)^k p
+size_t Graph::Skip(double p)
+{
+  if(p <= 0.0)
+    return SIZE_MAX / 2;
+  if(p >= 1.0)
+    return 0;
+
+  double k = std::floor(std::log(1.0 - mStream.GetDouble()) / std::log(1.0 - p));
+  return k < (double) (SIZE_MAX / 4) ? (size_t) k : SIZE_MAX / 4;
+}
+
+//Will move id from list from to list to, keeping mSlot right
+void Graph::MoveNode(size_t id, std::vector<size_t> & from, std::vector<size_t> & to)
+{
+  size_t slot = mNodes[id]->mSlot;
+  from[slot] = from.back();
+  mNodes[from[slot]]->mSlot = slot;
+  from.pop_back();
+
+  mNodes[id]->mSlot = to.size();
+  to.push_back(id);
 }
 
 
@@ -477,11 +1672,37 @@ void Graph::SetVote(size_t x, size_t y, size_t z)
 //Load the dna into all the hardware
 void Graph::SetGenome(program_t & pro)
 {
-  for(size_t i = 0; i < mGraph.size(); ++i)
+  for(size_t i = 0; i < mNodes.size(); ++i)
   {
-    for(size_t j = 0; j < mGraph.size(); ++j)
+    mNodes[i]->mHW->SetProgram(pro);
+    mNodes[i]->mEnemy = false;
+  }
+
+  mEnemies.clear();
+}
+
+//Will give bad to count random nodes and good back to the last ones that had bad
+//Only the nodes that change get a program, so one good genome serves many opponents
+void Graph::SetEnemies(const program_t & bad, const program_t & good, size_t count)
+{
+  for(size_t id : mEnemies)
+  {
+    mNodes[id]->mHW->SetProgram(good);
+    mNodes[id]->mEnemy = false;
+  }
+
+  mEnemies.clear();
+  count = std::min(count, mNodes.size());
+
+  while(mEnemies.size() < count)
+  {
+    size_t id = mStream.GetUInt(mNodes.size());
+
+    if(!mNodes[id]->mEnemy)
     {
-      mGraph[i][j]->mHW->SetProgram(pro);
+      mNodes[id]->mEnemy = true;
+      mNodes[id]->mHW->SetProgram(bad);
+      mEnemies.push_back(id);
     }
   }
 }
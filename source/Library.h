@@ -0,0 +1,253 @@
+#ifndef HP_LIBRARY_H
+#define HP_LIBRARY_H
+
+#include <iostream>
+#include <vector>
+
+#include "hp_config.h"
+#include "Graph.h"
+#include "../../Empirical/source/hardware/EventDrivenGP.h"
+
+/* CLASS USED TO HOLD THE INSTRUCTION AND EVENT LIBRARIES */
+
+//Built once and only read afterwards, so any number of Experiments can share
+//one Library. Nothing in here points at an Experiment: events are handed to
+//Graph::Current(), the graph running on the calling thread.
+class Library
+{
+  public:
+    Library(const HPConfig & config) :
+    UID(config.UID()), VOTE(config.VOTE()),
+    POSX(config.POSX()), POSY(config.POSY())
+    {
+      inst_lib = emp::NewPtr<inst_lib_t>();
+      event_lib = emp::NewPtr<event_lib_t>();
+      Library::Config_Inst();
+      Library::Config_Events();
+      SET_VOTE_ID = inst_lib->GetID("SetVote");
+      BROADCAST_ID = inst_lib->GetID("Broadcast");
+      CALL_ID = inst_lib->GetID("Call");
+    }
+
+    ~Library()
+    {
+      inst_lib.Delete();
+      event_lib.Delete();
+    }
+
+    /* FUNCTIONS DEDICATED TO THE CONFIGURATIONS, INSTRUCTIONS, EVENTS*/
+
+    //Will make the instruction library
+    void Config_Inst();
+
+    //Will set the output memory of a hardware to all of its neighboors
+    void Inst_BroadcastMail(hardware_t & hw, const inst_t & inst) const;
+
+    //Will send the vote to all of a hardwares neighboors
+    void Inst_BroadcastVote(hardware_t & hw, const inst_t & inst) const;
+
+    //Will load the UID of a hardware into its working buffer
+    void Inst_GetUID(hardware_t & hw, const inst_t & inst) const;
+
+    //Will get the vote of a hardware
+    void Inst_GetVote(hardware_t & hw, const inst_t & inst) const;
+
+
+    /* FUNCTIONS DEDICATED TO ANALYSIS */
+
+    //Will return if no node running pro can ever vote or broadcast
+    bool IsInert(const program_t & pro, double thresh) const;
+
+    //Will set the vote of the hardware
+    void Inst_SetVote(hardware_t & hw, const inst_t & inst) const;
+
+    //Will make the event library
+    void Config_Events();
+
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return the instruction library
+    emp::Ptr<inst_lib_t> GetInstLib() const {return inst_lib;}
+
+    //Return the event library
+    emp::Ptr<event_lib_t> GetEventLib() const {return event_lib;}
+
+    //Will return if config lays out the hardware traits the same way
+    bool Matches(const HPConfig & config) const
+    {
+      return (size_t) config.UID() == UID && config.VOTE() == VOTE &&
+             config.POSX() == POSX && config.POSY() == POSY;
+    }
+
+  private:
+    /* HARDWARE SPECIFIC PARAMATERS */
+
+    //Position of UID within hw trait vector
+    size_t UID;
+    //Position of VOTE within hw trait vector
+    size_t VOTE;
+    //Position of X coordinate within hw trait vector
+    size_t POSX;
+    //Position of Y coordinate within hw trait vector
+    size_t POSY;
+    //Instruction Library for hardware
+    emp::Ptr<inst_lib_t> inst_lib;
+    //Event Library for hardware
+    emp::Ptr<event_lib_t> event_lib;
+    //Instructions IsInert looks for
+    size_t SET_VOTE_ID;
+    size_t BROADCAST_ID;
+    size_t CALL_ID;
+};
+
+/* FUNCTIONS DEDICATED TO THE CONFIGURATIONS, INSTRUCTIONS, EVENTS */
+
+//Will make the instruction library
+void Library::Config_Inst()
+{
+
+  //Experiment specific instructions
+  inst_lib->AddInst("GetUID", [this](hardware_t & hw, const inst_t & inst) {this->Inst_GetUID(hw, inst);}, 1, "UID => Local Memory Arg1");
+  inst_lib->AddInst("Broadcast", [this](hardware_t & hw, const inst_t & inst) {this->Inst_BroadcastMail(hw, inst);}, 1, "Output Memory => hw.neighboors");
+  //inst_lib->AddInst("BroadcastVote", [this](hardware_t & hw, const inst_t & inst) {this->Inst_BroadcastVote(hw, inst);}, 1, "Output Memory[Arg1] = Vote => hw.neighboors");
+  inst_lib->AddInst("GetVote", [this](hardware_t & hw, const inst_t & inst) {this->Inst_GetVote(hw, inst);}, 1, "Vote => Local Memory Arg1");
+  inst_lib->AddInst("SetVote", [this](hardware_t & hw, const inst_t & inst) {this->Inst_SetVote(hw, inst);}, 1, "Local Memory Arg1 => Hw.Trait[VOTE]");
+
+  // - Setup the instruction set. -
+  // Standard instructions:
+
+  inst_lib->AddInst("Inc", hardware_t::Inst_Inc, 1, "Increment value in local memory Arg1");
+  inst_lib->AddInst("Dec", hardware_t::Inst_Dec, 1, "Decrement value in local memory Arg1");
+  inst_lib->AddInst("Not", hardware_t::Inst_Not, 1, "Logically toggle value in local memory Arg1");
+  inst_lib->AddInst("Add", hardware_t::Inst_Add, 3, "Local memory: Arg3 = Arg1 + Arg2");
+  inst_lib->AddInst("Sub", hardware_t::Inst_Sub, 3, "Local memory: Arg3 = Arg1 - Arg2");
+  inst_lib->AddInst("Mult", hardware_t::Inst_Mult, 3, "Local memory: Arg3 = Arg1 * Arg2");
+  inst_lib->AddInst("Div", hardware_t::Inst_Div, 3, "Local memory: Arg3 = Arg1 / Arg2");
+  inst_lib->AddInst("Mod", hardware_t::Inst_Mod, 3, "Local memory: Arg3 = Arg1 % Arg2");
+  inst_lib->AddInst("TestEqu", hardware_t::Inst_TestEqu, 3, "Local memory: Arg3 = (Arg1 == Arg2)");
+  inst_lib->AddInst("TestNEqu", hardware_t::Inst_TestNEqu, 3, "Local memory: Arg3 = (Arg1 != Arg2)");
+  inst_lib->AddInst("TestLess", hardware_t::Inst_TestLess, 3, "Local memory: Arg3 = (Arg1 < Arg2)");
+  inst_lib->AddInst("If", hardware_t::Inst_If, 1, "Local memory: If Arg1 != 0, proceed; else, skip block.", emp::ScopeType::BASIC, 0, {"block_def"});
+  inst_lib->AddInst("While", hardware_t::Inst_While, 1, "Local memory: If Arg1 != 0, loop; else, skip block.", emp::ScopeType::BASIC, 0, {"block_def"});
+  inst_lib->AddInst("Countdown", hardware_t::Inst_Countdown, 1, "Local memory: Countdown Arg1 to zero.", emp::ScopeType::BASIC, 0, {"block_def"});
+  inst_lib->AddInst("Close", hardware_t::Inst_Close, 0, "Close current block if there is a block to close.", emp::ScopeType::BASIC, 0, {"block_close"});
+  inst_lib->AddInst("Break", hardware_t::Inst_Break, 0, "Break out of current block.");
+  inst_lib->AddInst("Call", hardware_t::Inst_Call, 0, "Call function that best matches call affinity.", emp::ScopeType::BASIC, 0, {"affinity"});
+  inst_lib->AddInst("Return", hardware_t::Inst_Return, 0, "Return from current function if possible.");
+  inst_lib->AddInst("SetMem", hardware_t::Inst_SetMem, 2, "Local memory: Arg1 = numerical value of Arg2");
+  inst_lib->AddInst("CopyMem", hardware_t::Inst_CopyMem, 2, "Local memory: Arg1 = Arg2");
+  inst_lib->AddInst("SwapMem", hardware_t::Inst_SwapMem, 2, "Local memory: Swap values of Arg1 and Arg2.");
+  inst_lib->AddInst("Input", hardware_t::Inst_Input, 2, "Input memory Arg1 => Local memory Arg2.");
+  inst_lib->AddInst("Output", hardware_t::Inst_Output, 2, "Local memory Arg1 => Output memory Arg2.");
+  inst_lib->AddInst("Commit", hardware_t::Inst_Commit, 2, "Local memory Arg1 => Shared memory Arg2.");
+  inst_lib->AddInst("Pull", hardware_t::Inst_Pull, 2, "Shared memory Arg1 => Local memory Arg2.");
+  inst_lib->AddInst("Nop", hardware_t::Inst_Nop, 0, "No operation.");
+
+
+}
+
+//Will set the output memory of a hardware to all of its neighboors
+void Library::Inst_BroadcastMail(hardware_t & hw, const inst_t & inst) const
+{
+  state_t & state = hw.GetCurState();
+  hw.TriggerEvent("BroadcastMail", inst.affinity, state.output_mem);
+}
+
+//Will set the output memory of a hardware to all of its neighboors
+void Library::Inst_BroadcastVote(hardware_t & hw, const inst_t & inst) const
+{
+  double vote = hw.GetTrait(VOTE);
+  state_t & state = hw.GetCurState();
+  state.SetOutput(inst.args[0], vote);
+
+  hw.TriggerEvent("BroadcastVote", inst.affinity, state.output_mem);
+}
+
+//Will load the UID of a hardware into its working buffer
+void Library::Inst_GetUID(hardware_t & hw, const inst_t & inst) const
+{
+  state_t & state = hw.GetCurState();
+  state.SetLocal(inst.args[0], hw.GetTrait(UID));
+}
+
+//Will get the vote of a hardware
+void Library::Inst_GetVote(hardware_t & hw, const inst_t & inst) const
+{
+  state_t & state = hw.GetCurState();
+  state.SetLocal(inst.args[0], hw.GetTrait(VOTE));
+}
+
+//Will set the vote of the hardware
+void Library::Inst_SetVote(hardware_t & hw, const inst_t & inst) const
+{
+  state_t & state = hw.GetCurState();
+  double vote = state.GetLocal(inst.args[0]);
+  hw.SetTrait(VOTE, vote);
+  Graph::Current()->MarkVotes(hw);
+}
+
+/* FUNCTIONS DEDICATED TO ANALYSIS */
+
+//Will return if no node running pro can ever vote or broadcast
+//Only function 0 (the main core) starts without a tag. Call can run any function
+//whose tag binds at thresh or better, so marking all of them over-approximates
+//what runs. Mail only comes from Broadcast, so if no marked function votes or
+//broadcasts, no node ever does and every vote stays the illegal -999.
+bool Library::IsInert(const program_t & pro, double thresh) const
+{
+  size_t n = pro.GetSize();
+  if(n == 0)
+    return false;
+
+  std::vector<bool> seen(n, false);
+  std::vector<size_t> todo(1, 0);
+  seen[0] = true;
+
+  while(!todo.empty())
+  {
+    const function_t & fun = pro[todo.back()];
+    todo.pop_back();
+
+    for(const inst_t & inst : fun.inst_seq)
+    {
+      if(inst.id == SET_VOTE_ID || inst.id == BROADCAST_ID)
+        return false;
+
+      if(inst.id != CALL_ID)
+        continue;
+
+      for(size_t f = 0; f < n; ++f)
+      {
+        if(!seen[f] && emp::SimpleMatchCoeff(inst.affinity, pro[f].affinity) >= thresh)
+        {
+          seen[f] = true;
+          todo.push_back(f);
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+//Will make the event library
+//Every handler works on the graph that is running on this thread
+void Library::Config_Events()
+{
+  auto handle = [](hardware_t & hw, const event_t & e) {Graph::Current()->Handle_Broadcast(hw, e);};
+
+  event_lib->AddEvent("BroadcastMail", handle, "Send output memory to all neighbors.");
+  event_lib->RegisterDispatchFun("BroadcastMail", [](hardware_t & hw, const event_t & e)
+  {
+    Graph::Current()->Broadcast(hw, e);
+  });
+
+  event_lib->AddEvent("BroadcastVote", handle, "Send output memory to all neighbors.");
+  event_lib->RegisterDispatchFun("BroadcastVote", [](hardware_t & hw, const event_t & e)
+  {
+    Graph::Current()->BroadcastVote(hw, e);
+  });
+}
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef HP_LINEAGE_H
+#define HP_LINEAGE_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+
+/* CLASS USED TO TRACK THE ANCESTRY OF THE POPULATION */
+
+//Agents with the same genome share a taxon and every mutation starts a new
+//one, so taxa form a tree rooted at the ancestor. Only what the living
+//population descends from is kept:
+//  - a taxon with no living agents and no child taxa is removed
+//  - a taxon with no living agents and one child taxon is spliced out
+//Every kept taxon is then either alive or a branch point, so the tree never
+//holds more than twice as many taxa as there are living lineages.
+class Lineage
+{
+  public:
+    //Parent of the root
+    static constexpr size_t NONE = SIZE_MAX;
+
+    /* FUNCTIONS DEDICATED TO TRACKING */
+
+    //Will put all pop agents into one root taxon born at gen
+    void Reset(size_t pop, size_t gen = 0);
+
+    //Will record that the agent born at child in the next population copies parent
+    void Birth(size_t child, size_t parent);
+
+    //Will make the next population current and prune extinct taxa
+    void Update();
+
+    //Will move the agent at pos into a new taxon born at gen
+    void Mutated(size_t pos, size_t gen);
+
+    //Will add an evaluation score to the taxon of the agent at pos
+    void Score(size_t pos, double score);
+
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return number of taxa kept
+    size_t GetTaxaCnt() const {return mTaxa.size() - mFree.size();}
+
+    //Return taxon of the agent at pos
+    size_t GetTaxon(size_t pos) const {return mCur[pos];}
+
+
+    /* FUNCTIONS DEDICATED TO PRINTING OUT CRAP */
+
+    //Will print the taxa from the agent at pos back to the root
+    void PrintAncestry(size_t pos, std::ostream & os = std::cout) const;
+
+  private:
+    struct Taxon
+    {
+      //Taxon this one mutated from
+      size_t mParent = NONE;
+      //Generation it was born in
+      size_t mOrigin = 0;
+      //Mutation events between it and the root, kept exact across splices
+      size_t mDepth = 0;
+      //Living agents in it
+      size_t mLive = 0;
+      //Kept child taxa
+      std::vector<size_t> mKids;
+      //Scores of its agents
+      double mBest = 0;
+      double mTotal = 0;
+      size_t mScored = 0;
+    };
+
+    //Will return a fresh taxon under parent
+    size_t NewTaxon(size_t parent, size_t gen);
+
+    //Will remove or splice t and its ancestors while they are no longer needed
+    void Release(size_t t);
+
+    //Will swap old for now in the child list of parent, or drop old if now is NONE
+    void ReplaceKid(size_t parent, size_t old, size_t now);
+
+    //All taxa, indexed by id
+    std::vector<Taxon> mTaxa;
+    //Ids free for reuse
+    std::vector<size_t> mFree;
+    //Taxon of every agent in the current and next populations
+    std::vector<size_t> mCur;
+    std::vector<size_t> mNext;
+};
+
+/* FUNCTIONS DEDICATED TO TRACKING */
+
+//Will put all pop agents into one root taxon born at gen
+void Lineage::Reset(size_t pop, size_t gen)
+{
+  mTaxa.clear();
+  mFree.clear();
+
+  size_t root = Lineage::NewTaxon(NONE, gen);
+  mTaxa[root].mLive = pop;
+  mCur.assign(pop, root);
+  mNext.assign(pop, root);
+}
+
+//Will record that the agent born at child in the next population copies parent
+void Lineage::Birth(size_t child, size_t parent)
+{
+  size_t t = mCur[parent];
+  mNext[child] = t;
+  ++mTaxa[t].mLive;
+}
+
+//Will make the next population current and prune extinct taxa
+//Births were counted first, so only taxa without offspring reach zero
+void Lineage::Update()
+{
+  for(size_t t : mCur)
+  {
+    if(--mTaxa[t].mLive == 0)
+      Lineage::Release(t);
+  }
+
+  std::swap(mCur, mNext);
+}
+
+//Will move the agent at pos into a new taxon born at gen
+void Lineage::Mutated(size_t pos, size_t gen)
+{
+  size_t old = mCur[pos];
+  size_t t = Lineage::NewTaxon(old, gen);
+
+  mTaxa[t].mLive = 1;
+  --mTaxa[old].mLive;
+  mCur[pos] = t;
+
+  //old has a child now, but may have been its only agent
+  if(mTaxa[old].mLive == 0)
+    Lineage::Release(old);
+}
+
+//Will add an evaluation score to the taxon of the agent at pos
+void Lineage::Score(size_t pos, double score)
+{
+  Taxon & t = mTaxa[mCur[pos]];
+
+  if(t.mScored == 0 || score > t.mBest)
+    t.mBest = score;
+
+  t.mTotal += score;
+  ++t.mScored;
+}
+
+//Will return a fresh taxon under parent
+size_t Lineage::NewTaxon(size_t parent, size_t gen)
+{
+  size_t t;
+
+  if(mFree.empty())
+  {
+    t = mTaxa.size();
+    mTaxa.emplace_back();
+  }
+
+  else
+  {
+    t = mFree.back();
+    mFree.pop_back();
+    mTaxa[t] = Taxon();
+  }
+
+  mTaxa[t].mParent = parent;
+  mTaxa[t].mOrigin = gen;
+
+  if(parent != NONE)
+  {
+    mTaxa[t].mDepth = mTaxa[parent].mDepth + 1;
+    mTaxa[parent].mKids.push_back(t);
+  }
+
+  return t;
+}
+
+//Will remove or splice t and its ancestors while they are no longer needed
+void Lineage::Release(size_t t)
+{
+  while(t != NONE && mTaxa[t].mLive == 0)
+  {
+    Taxon & x = mTaxa[t];
+    size_t parent = x.mParent;
+
+    //Extinct leaf: drop it and look at the parent
+    if(x.mKids.empty())
+    {
+      if(parent != NONE)
+        Lineage::ReplaceKid(parent, t, NONE);
+
+      std::vector<size_t>().swap(x.mKids);
+      mFree.push_back(t);
+      t = parent;
+      continue;
+    }
+
+    //Extinct link in a chain: hand its only child to the parent
+    if(x.mKids.size() == 1)
+    {
+      size_t kid = x.mKids[0];
+      mTaxa[kid].mParent = parent;
+
+      if(parent != NONE)
+        Lineage::ReplaceKid(parent, t, kid);
+
+      std::vector<size_t>().swap(x.mKids);
+      mFree.push_back(t);
+    }
+
+    return;
+  }
+}
+
+//Will swap old for now in the child list of parent, or drop old if now is NONE
+void Lineage::ReplaceKid(size_t parent, size_t old, size_t now)
+{
+  std::vector<size_t> & kids = mTaxa[parent].mKids;
+
+  for(size_t i = 0; i < kids.size(); ++i)
+  {
+    if(kids[i] != old)
+      continue;
+
+    if(now == NONE)
+    {
+      kids[i] = kids.back();
+      kids.pop_back();
+    }
+
+    else
+    {
+      kids[i] = now;
+    }
+
+    return;
+  }
+}
+
+/* FUNCTIONS DEDICATED TO PRINTING OUT CRAP */
+
+//Will print the taxa from the agent at pos back to the root
+void Lineage::PrintAncestry(size_t pos, std::ostream & os) const
+{
+  os << "taxon,origin,depth,live,scored,best,mean" << std::endl;
+
+  for(size_t t = mCur[pos]; t != NONE; t = mTaxa[t].mParent)
+  {
+    const Taxon & x = mTaxa[t];
+    os << t << "," << x.mOrigin << "," << x.mDepth << "," << x.mLive << "," << x.mScored << ","
+       << x.mBest << "," << (x.mScored ? x.mTotal / x.mScored : 0.0) << std::endl;
+  }
+}
+
+#endif
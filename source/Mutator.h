@@ -0,0 +1,325 @@
+#ifndef HP_MUTATOR_H
+#define HP_MUTATOR_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "hp_config.h"
+#include "PackedGenome.h"
+#include "../../Empirical/source/tools/Random.h"
+
+/* CLASS USED TO MUTATE PACKED GENOMES IN PLACE */
+
+//Same operators and limits as the SignalGP mutator this replaces: function
+//duplication and deletion, slips, instruction insertion and deletion, then
+//instruction, argument and tag bit substitutions, each at a per site rate.
+//Instead of drawing for every site, the gap to the next hit site is drawn
+//from the geometric distribution, so a pass costs one draw per mutation plus
+//one, whatever the genome length. Edits go straight into the packed buffer,
+//and the site lists are kept between calls.
+class Mutator
+{
+  public:
+    Mutator(const HPConfig & config, size_t num_insts) :
+    MIN_FUN_CNT(std::max<size_t>(1, config.MIN_FUN_CNT())), MAX_FUN_CNT(config.MAX_FUN_CNT()),
+    MIN_FUN_LEN(config.MIN_FUN_LEN()), MAX_FUN_LEN(config.MAX_FUN_LEN()),
+    MAX_TOT_LEN(config.MAX_TOT_LEN()), NUM_INSTS(num_insts),
+    MAX_ARG_VAL(std::max<size_t>(1, std::min<size_t>(PACK_ARG_MAX + 1, config.MAX_ARG_VAL())))
+    {
+      mFunDup = LogMiss(config.MUT_FUNC_DUP());
+      mFunDel = LogMiss(config.MUT_FUNC_DEL());
+      mSlip = LogMiss(config.MUT_SLIP());
+      mInstIns = LogMiss(config.MUT_INST_INS());
+      mInstDel = LogMiss(config.MUT_INST_DEL());
+      mInstSub = LogMiss(config.MUT_INST_SUB());
+      mArgSub = LogMiss(config.MUT_ARG_SUB());
+      mTagFlip = LogMiss(config.MUT_TAG_FLIP());
+    }
+
+    /* FUNCTIONS DEDICATED TO MUTATING */
+
+    //Will mutate genome in place, returns number of mutations
+    size_t Mutate(PackedGenome & genome, emp::Random & rnd);
+
+  private:
+    //Will return log(1 - rate), what Next needs of a rate
+    static double LogMiss(double rate) {return rate <= 0.0 ? 0.0 : (rate >= 1.0 ? -INFINITY : std::log1p(-rate));}
+
+    //Will move site to the next hit site below n, false if there is none
+    //Sites are hit independently, so the misses before a hit are geometric
+    static bool Next(emp::Random & rnd, double log_miss, size_t & site, size_t n)
+    {
+      if(log_miss == 0.0 || site >= n)
+        return false;
+
+      double gap = std::floor(std::log(1.0 - rnd.GetDouble()) / log_miss);
+      if(gap >= (double) (n - site))
+        return false;
+
+      site += (size_t) gap;
+      return true;
+    }
+
+    //Will return the function holding instruction k
+    size_t FunOf(const PackedGenome & genome, size_t k) const;
+
+    //Will set instruction k to a random one
+    void RandomInst(PackedGenome & genome, size_t k, emp::Random & rnd) const;
+
+    //Will return a random tag
+    static uint16_t RandomTag(emp::Random & rnd) {return rnd.GetUInt(1u << TAG_WIDTH);}
+
+    //Will duplicate and delete whole functions
+    size_t MutateFunctions(PackedGenome & genome, emp::Random & rnd);
+
+    //Will duplicate or delete a random stretch of some functions
+    size_t MutateSlips(PackedGenome & genome, emp::Random & rnd);
+
+    //Will insert and delete single instructions
+    size_t MutateIndels(PackedGenome & genome, emp::Random & rnd);
+
+    //Will substitute instructions, arguments and tag bits
+    size_t MutatePoints(PackedGenome & genome, emp::Random & rnd);
+
+    /* LIMITS */
+
+    size_t MIN_FUN_CNT;
+    size_t MAX_FUN_CNT;
+    size_t MIN_FUN_LEN;
+    size_t MAX_FUN_LEN;
+    size_t MAX_TOT_LEN;
+    //Instructions in the library
+    size_t NUM_INSTS;
+    //Arguments are drawn from [0, MAX_ARG_VAL)
+    size_t MAX_ARG_VAL;
+
+    /* log(1 - rate) OF EVERY OPERATOR */
+
+    double mFunDup;
+    double mFunDel;
+    double mSlip;
+    double mInstIns;
+    double mInstDel;
+    double mInstSub;
+    double mArgSub;
+    double mTagFlip;
+
+    //Sites hit in the current pass, reused between calls
+    //Indels keep (k, is insertion) so both kinds can be applied back to front
+    std::vector<size_t> mSites;
+    std::vector<std::pair<size_t, bool>> mIndels;
+};
+
+/* FUNCTIONS DEDICATED TO MUTATING */
+
+//Will mutate genome in place, returns number of mutations
+//Structure changes first, so the point mutations land on the final layout
+size_t Mutator::Mutate(PackedGenome & genome, emp::Random & rnd)
+{
+  size_t muts = 0;
+  muts += Mutator::MutateFunctions(genome, rnd);
+  muts += Mutator::MutateSlips(genome, rnd);
+  muts += Mutator::MutateIndels(genome, rnd);
+  muts += Mutator::MutatePoints(genome, rnd);
+  return muts;
+}
+
+//Will return the function holding instruction k
+size_t Mutator::FunOf(const PackedGenome & genome, size_t k) const
+{
+  size_t lo = 0, hi = genome.GetSize();
+
+  //Last function starting at or before k, empty functions are skipped over
+  while(hi - lo > 1)
+  {
+    size_t mid = (lo + hi) / 2;
+    if(genome.GetFunStart(mid) <= k)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+//Will set instruction k to a random one
+void Mutator::RandomInst(PackedGenome & genome, size_t k, emp::Random & rnd) const
+{
+  genome.SetInstID(k, rnd.GetUInt(NUM_INSTS));
+  for(size_t a = 0; a < 3; ++a)
+    genome.SetArg(k, a, rnd.GetUInt(MAX_ARG_VAL));
+  genome.SetInstTag(k, Mutator::RandomTag(rnd));
+}
+
+//Will duplicate and delete whole functions
+//Copies go to the end, so the functions drawn keep their index until the deletions,
+//which run back to front
+size_t Mutator::MutateFunctions(PackedGenome & genome, emp::Random & rnd)
+{
+  size_t muts = 0;
+  size_t funs = genome.GetSize();
+
+  for(size_t f = 0; Mutator::Next(rnd, mFunDup, f, funs); ++f)
+  {
+    size_t len = genome.GetFunSize(f);
+    if(genome.GetSize() >= MAX_FUN_CNT || genome.GetInstCnt() + len > MAX_TOT_LEN)
+      continue;
+
+    size_t copy = genome.GetSize();
+    genome.AddFunction(genome.GetFunTag(f));
+    genome.InsertInsts(copy, 0, len);
+    genome.CopyInsts(genome.GetFunStart(f), genome.GetFunStart(copy), len);
+    ++muts;
+  }
+
+  mSites.clear();
+  for(size_t f = 0; Mutator::Next(rnd, mFunDel, f, funs); ++f)
+    mSites.push_back(f);
+
+  for(auto it = mSites.rbegin(); it != mSites.rend(); ++it)
+  {
+    if(genome.GetSize() <= MIN_FUN_CNT)
+      break;
+
+    genome.EraseFunction(*it);
+    ++muts;
+  }
+
+  return muts;
+}
+
+//Will duplicate or delete a random stretch of some functions
+//Two points are drawn: in order they mark a stretch copied right after itself,
+//reversed they mark a stretch deleted, as long as the limits hold
+size_t Mutator::MutateSlips(PackedGenome & genome, emp::Random & rnd)
+{
+  size_t muts = 0;
+
+  for(size_t f = 0; Mutator::Next(rnd, mSlip, f, genome.GetSize()); ++f)
+  {
+    size_t len = genome.GetFunSize(f);
+    if(len == 0)
+      continue;
+
+    size_t begin = rnd.GetUInt(len);
+    size_t end = rnd.GetUInt(len);
+
+    if(begin < end)
+    {
+      size_t n = end - begin;
+      if(genome.GetInstCnt() + n > MAX_TOT_LEN || len + n > MAX_FUN_LEN)
+        continue;
+
+      genome.InsertInsts(f, end, n);
+      genome.CopyInsts(genome.GetIndex(f, begin), genome.GetIndex(f, end), n);
+      ++muts;
+    }
+
+    else if(end < begin)
+    {
+      size_t n = begin - end;
+      if(len - n < MIN_FUN_LEN)
+        continue;
+
+      genome.EraseInsts(f, end, n);
+      ++muts;
+    }
+  }
+
+  return muts;
+}
+
+//Will insert and delete single instructions
+//Both kinds are drawn over the instructions as they are, then applied from the
+//back so every k drawn still points at the instruction it was drawn for.
+//An insertion puts a random instruction before k.
+size_t Mutator::MutateIndels(PackedGenome & genome, emp::Random & rnd)
+{
+  size_t muts = 0;
+  size_t insts = genome.GetInstCnt();
+
+  mIndels.clear();
+  for(size_t k = 0; Mutator::Next(rnd, mInstIns, k, insts); ++k)
+    mIndels.emplace_back(k, true);
+  for(size_t k = 0; Mutator::Next(rnd, mInstDel, k, insts); ++k)
+    mIndels.emplace_back(k, false);
+
+  if(mIndels.empty())
+    return 0;
+
+  //Going back to front, a deletion at k runs before an insertion at k, so it still
+  //removes the instruction it was drawn for and the new one takes its place
+  std::sort(mIndels.begin(), mIndels.end(), [](const std::pair<size_t, bool> & a, const std::pair<size_t, bool> & b)
+  {
+    return a.first != b.first ? a.first < b.first : a.second > b.second;
+  });
+
+  for(auto it = mIndels.rbegin(); it != mIndels.rend(); ++it)
+  {
+    size_t k = it->first;
+    size_t f = Mutator::FunOf(genome, k);
+    size_t i = k - genome.GetFunStart(f);
+    size_t len = genome.GetFunSize(f);
+
+    if(it->second)
+    {
+      if(len >= MAX_FUN_LEN || genome.GetInstCnt() >= MAX_TOT_LEN)
+        continue;
+
+      genome.InsertInsts(f, i, 1);
+      Mutator::RandomInst(genome, k, rnd);
+      ++muts;
+    }
+
+    else
+    {
+      if(len <= MIN_FUN_LEN)
+        continue;
+
+      genome.EraseInsts(f, i, 1);
+      ++muts;
+    }
+  }
+
+  return muts;
+}
+
+//Will substitute instructions, arguments and tag bits
+//Argument sites are 3 per instruction, tag bit sites TAG_WIDTH per instruction
+//followed by TAG_WIDTH per function
+size_t Mutator::MutatePoints(PackedGenome & genome, emp::Random & rnd)
+{
+  size_t muts = 0;
+  size_t insts = genome.GetInstCnt();
+  size_t funs = genome.GetSize();
+
+  for(size_t k = 0; Mutator::Next(rnd, mInstSub, k, insts); ++k)
+  {
+    genome.SetInstID(k, rnd.GetUInt(NUM_INSTS));
+    ++muts;
+  }
+
+  for(size_t s = 0; Mutator::Next(rnd, mArgSub, s, 3 * insts); ++s)
+  {
+    genome.SetArg(s / 3, s % 3, rnd.GetUInt(MAX_ARG_VAL));
+    ++muts;
+  }
+
+  for(size_t s = 0; Mutator::Next(rnd, mTagFlip, s, TAG_WIDTH * (insts + funs)); ++s)
+  {
+    size_t k = s / TAG_WIDTH;
+    uint16_t bit = 1u << (s % TAG_WIDTH);
+
+    if(k < insts)
+      genome.SetInstTag(k, genome.GetInstTag(k) ^ bit);
+    else
+      genome.SetFunTag(k - insts, genome.GetFunTag(k - insts) ^ bit);
+    ++muts;
+  }
+
+  return muts;
+}
+
+#endif
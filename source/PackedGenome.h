@@ -0,0 +1,303 @@
+#ifndef HP_PACKEDGENOME_H
+#define HP_PACKEDGENOME_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include "Graph.h"
+#include "../../Empirical/source/base/assert.h"
+
+/* CONSTEXPR FOR PACKING */
+
+//Bits given to each instruction argument
+constexpr size_t PACK_ARG_BITS = 5;
+//Largest argument value that can be packed
+constexpr size_t PACK_ARG_MAX = (1 << PACK_ARG_BITS) - 1;
+//Largest opcode that can be packed
+constexpr size_t PACK_OP_MAX = 255;
+
+static_assert(TAG_WIDTH <= 16, "PackedGenome stores tags in 16 bits.");
+
+/* CLASS USED TO STORE A RESTING GENOME IN A FEW BYTES PER INSTRUCTION */
+
+//Everything lives in one byte buffer so a genome is a single allocation:
+//  [funs u16][starts u16 x (funs+1)][fun tags u16 x funs]
+//  [ops u8 x insts][args u16 x insts][inst tags u16 x insts]
+//Each instruction costs 5 bytes (opcode, three 5 bit args, tag).
+class PackedGenome
+{
+  public:
+    PackedGenome() {;}
+    PackedGenome(const program_t & pro) {Pack(pro);}
+
+    /* FUNCTIONS DEDICATED TO PACKING */
+
+    //Will compress a full program into the buffer
+    void Pack(const program_t & pro);
+
+    //Will expand the buffer into pro, reusing the memory pro already owns
+    void Unpack(program_t & pro) const;
+
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return number of functions
+    size_t GetSize() const {return mData.size() ? Read16(0) : 0;}
+
+    //Return total number of instructions
+    size_t GetInstCnt() const {return mData.size() ? Read16(2 + 2 * GetSize()) : 0;}
+
+    //Return number of instructions in function f
+    size_t GetFunSize(size_t f) const {return Read16(2 + 2 * (f + 1)) - Read16(2 + 2 * f);}
+
+    //Return the tag of function f
+    uint16_t GetFunTag(size_t f) const {return Read16(FunTagOff() + 2 * f);}
+
+    //Return the opcode of instruction i in function f
+    size_t GetInstID(size_t f, size_t i) const {return mData[OpOff() + Index(f, i)];}
+
+    //Return argument a of instruction i in function f
+    int GetArg(size_t f, size_t i, size_t a) const
+    {
+      return (Read16(ArgOff() + 2 * Index(f, i)) >> (a * PACK_ARG_BITS)) & PACK_ARG_MAX;
+    }
+
+    //Return the tag of instruction i in function f
+    uint16_t GetInstTag(size_t f, size_t i) const {return Read16(TagOff() + 2 * Index(f, i));}
+
+    //Return how many bytes the buffer holds
+    size_t GetBytes() const {return mData.capacity();}
+
+    //Return the raw buffer, e.g. for writing to disk
+    const std::vector<uint8_t> & GetData() const {return mData;}
+
+
+    /* FUNCTIONS DEDICATED TO BE SETTERS */
+
+    //Will load a buffer previously returned by GetData()
+    void SetData(const uint8_t * data, size_t n) {mData.assign(data, data + n);}
+
+
+    /* FUNCTIONS DEDICATED TO EDITING IN PLACE */
+
+    //Instructions are numbered k over the whole genome, function after function
+
+    //Return k of instruction i in function f
+    size_t GetIndex(size_t f, size_t i) const {return Index(f, i);}
+
+    //Return k of the first instruction of function f, f == GetSize() gives GetInstCnt()
+    size_t GetFunStart(size_t f) const {return Read16(2 + 2 * f);}
+
+    //Will set the tag of function f
+    void SetFunTag(size_t f, uint16_t tag) {Write16(FunTagOff() + 2 * f, tag);}
+
+    //Will set the opcode of instruction k
+    void SetInstID(size_t k, size_t id)
+    {
+      emp_assert(id <= PACK_OP_MAX);
+      mData[OpOff() + k] = id;
+    }
+
+    //Will set argument a of instruction k
+    void SetArg(size_t k, size_t a, int v)
+    {
+      emp_assert(v >= 0 && (size_t) v <= PACK_ARG_MAX);
+      uint16_t args = Read16(ArgOff() + 2 * k) & ~(PACK_ARG_MAX << (a * PACK_ARG_BITS));
+      Write16(ArgOff() + 2 * k, args | (v << (a * PACK_ARG_BITS)));
+    }
+
+    //Return and set the tag of instruction k
+    uint16_t GetInstTag(size_t k) const {return Read16(TagOff() + 2 * k);}
+    void SetInstTag(size_t k, uint16_t tag) {Write16(TagOff() + 2 * k, tag);}
+
+    //Will open room for n instructions before instruction i of function f, to be set by the caller
+    void InsertInsts(size_t f, size_t i, size_t n);
+
+    //Will remove n instructions of function f from instruction i on
+    void EraseInsts(size_t f, size_t i, size_t n);
+
+    //Will copy n instructions from k onto to, the ranges must not overlap
+    void CopyInsts(size_t k, size_t to, size_t n);
+
+    //Will append a function with no instructions
+    void AddFunction(uint16_t tag);
+
+    //Will remove function f and its instructions
+    void EraseFunction(size_t f);
+
+  private:
+    /* HELPERS FOR THE LAYOUT */
+
+    size_t FunTagOff() const {return 2 + 2 * (GetSize() + 1);}
+    size_t OpOff() const {return FunTagOff() + 2 * GetSize();}
+    size_t ArgOff() const {return OpOff() + GetInstCnt();}
+    size_t TagOff() const {return ArgOff() + 2 * GetInstCnt();}
+    size_t Index(size_t f, size_t i) const {return Read16(2 + 2 * f) + i;}
+
+    uint16_t Read16(size_t off) const
+    {
+      uint16_t v;
+      std::memcpy(&v, &mData[off], sizeof(v));
+      return v;
+    }
+
+    void Write16(size_t off, uint16_t v)
+    {
+      std::memcpy(&mData[off], &v, sizeof(v));
+    }
+
+    //Holder of the packed genome
+    std::vector<uint8_t> mData;
+};
+
+/* FUNCTIONS DEDICATED TO PACKING */
+
+//Will compress a full program into the buffer
+void PackedGenome::Pack(const program_t & pro)
+{
+  size_t funs = pro.GetSize();
+  size_t insts = 0;
+
+  for(size_t f = 0; f < funs; ++f)
+  {
+    insts += pro[f].GetSize();
+  }
+
+  emp_assert(insts <= UINT16_MAX);
+  mData.resize(2 + 2 * (funs + 1) + 2 * funs + 5 * insts);
+
+  Write16(0, funs);
+  size_t start = 0;
+  for(size_t f = 0; f < funs; ++f)
+  {
+    Write16(2 + 2 * f, start);
+    start += pro[f].GetSize();
+  }
+  Write16(2 + 2 * funs, start);
+
+  size_t k = 0;
+  for(size_t f = 0; f < funs; ++f)
+  {
+    Write16(FunTagOff() + 2 * f, pro[f].affinity.GetUInt(0));
+
+    for(size_t i = 0; i < pro[f].GetSize(); ++i, ++k)
+    {
+      const inst_t & inst = pro[f][i];
+      emp_assert(inst.id <= PACK_OP_MAX);
+
+      uint16_t args = 0;
+      for(size_t a = 0; a < 3; ++a)
+      {
+        emp_assert(inst.args[a] >= 0 && (size_t) inst.args[a] <= PACK_ARG_MAX);
+        args |= (inst.args[a] & PACK_ARG_MAX) << (a * PACK_ARG_BITS);
+      }
+
+      mData[OpOff() + k] = inst.id;
+      Write16(ArgOff() + 2 * k, args);
+      Write16(TagOff() + 2 * k, inst.affinity.GetUInt(0));
+    }
+  }
+}
+
+//Will expand the buffer into pro, reusing the memory pro already owns
+void PackedGenome::Unpack(program_t & pro) const
+{
+  size_t funs = GetSize();
+  pro.program.resize(funs);
+
+  for(size_t f = 0; f < funs; ++f)
+  {
+    function_t & fun = pro.program[f];
+    fun.affinity.SetUInt(0, GetFunTag(f));
+    fun.inst_seq.resize(GetFunSize(f));
+
+    for(size_t i = 0; i < fun.inst_seq.size(); ++i)
+    {
+      inst_t & inst = fun.inst_seq[i];
+      inst.id = GetInstID(f, i);
+      inst.args[0] = GetArg(f, i, 0);
+      inst.args[1] = GetArg(f, i, 1);
+      inst.args[2] = GetArg(f, i, 2);
+      inst.affinity.SetUInt(0, GetInstTag(f, i));
+    }
+  }
+}
+
+/* FUNCTIONS DEDICATED TO EDITING IN PLACE */
+
+//Will open room for n instructions before instruction i of function f, to be set by the caller
+//Each column moves once, so the cost is one memmove of the buffer
+void PackedGenome::InsertInsts(size_t f, size_t i, size_t n)
+{
+  size_t k = Index(f, i);
+  size_t op = OpOff(), arg = ArgOff(), tag = TagOff();
+  emp_assert(GetInstCnt() + n <= UINT16_MAX);
+
+  //Last column first, so the offsets of the others still hold
+  mData.insert(mData.begin() + tag + 2 * k, 2 * n, 0);
+  mData.insert(mData.begin() + arg + 2 * k, 2 * n, 0);
+  mData.insert(mData.begin() + op + k, n, 0);
+
+  for(size_t g = f + 1; g <= GetSize(); ++g)
+    Write16(2 + 2 * g, Read16(2 + 2 * g) + n);
+}
+
+//Will remove n instructions of function f from instruction i on
+void PackedGenome::EraseInsts(size_t f, size_t i, size_t n)
+{
+  size_t k = Index(f, i);
+  size_t op = OpOff(), arg = ArgOff(), tag = TagOff();
+  emp_assert(i + n <= GetFunSize(f));
+
+  mData.erase(mData.begin() + tag + 2 * k, mData.begin() + tag + 2 * (k + n));
+  mData.erase(mData.begin() + arg + 2 * k, mData.begin() + arg + 2 * (k + n));
+  mData.erase(mData.begin() + op + k, mData.begin() + op + k + n);
+
+  for(size_t g = f + 1; g <= GetSize(); ++g)
+    Write16(2 + 2 * g, Read16(2 + 2 * g) - n);
+}
+
+//Will copy n instructions from k onto to, the ranges must not overlap
+void PackedGenome::CopyInsts(size_t k, size_t to, size_t n)
+{
+  emp_assert(k + n <= to || to + n <= k);
+
+  std::memcpy(&mData[OpOff() + to], &mData[OpOff() + k], n);
+  std::memcpy(&mData[ArgOff() + 2 * to], &mData[ArgOff() + 2 * k], 2 * n);
+  std::memcpy(&mData[TagOff() + 2 * to], &mData[TagOff() + 2 * k], 2 * n);
+}
+
+//Will append a function with no instructions
+void PackedGenome::AddFunction(uint16_t tag)
+{
+  size_t funs = GetSize();
+  size_t insts = GetInstCnt();
+  uint8_t bytes[2];
+
+  //Its tag goes after the last function tag, then its end after the last start
+  std::memcpy(bytes, &tag, 2);
+  mData.insert(mData.begin() + FunTagOff() + 2 * funs, bytes, bytes + 2);
+
+  uint16_t end = insts;
+  std::memcpy(bytes, &end, 2);
+  mData.insert(mData.begin() + 2 + 2 * (funs + 1), bytes, bytes + 2);
+
+  Write16(0, funs + 1);
+}
+
+//Will remove function f and its instructions
+void PackedGenome::EraseFunction(size_t f)
+{
+  EraseInsts(f, 0, GetFunSize(f));
+
+  //Its start and end are equal now, so either can go
+  size_t funs = GetSize();
+  mData.erase(mData.begin() + FunTagOff() + 2 * f, mData.begin() + FunTagOff() + 2 * (f + 1));
+  mData.erase(mData.begin() + 2 + 2 * (f + 1), mData.begin() + 2 + 2 * (f + 2));
+
+  Write16(0, funs - 1);
+}
+
+#endif
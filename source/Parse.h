@@ -0,0 +1,34 @@
+#ifndef HP_PARSE_H
+#define HP_PARSE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/* FUNCTIONS DEDICATED TO READING NUMBERS FROM TEXT */
+
+//Will read text as a number, false unless it is digits (spaces around allowed) that fit
+//Used where std::stoul would throw on a bad command line or list entry
+inline bool ReadNumber(const std::string & text, size_t & out)
+{
+  size_t begin = text.find_first_not_of(" ");
+  size_t end = text.find_last_not_of(" ");
+  if(begin == std::string::npos)
+    return false;
+
+  out = 0;
+  for(size_t k = begin; k <= end; ++k)
+  {
+    if(text[k] < '0' || text[k] > '9')
+      return false;
+
+    size_t digit = text[k] - '0';
+    if(out > (SIZE_MAX - digit) / 10)
+      return false;
+    out = out * 10 + digit;
+  }
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef HP_PERFCOUNTER_H
+#define HP_PERFCOUNTER_H
+
+#include <cstdint>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* CLASS USED TO COUNT THE CACHE MISSES OF THE CALLING THREAD */
+
+//Wraps one perf_event_open counter of last level cache misses in user space.
+//Only the thread that opened it is counted. Containers and locked down
+//kernels (perf_event_paranoid) often refuse the counter: Open then returns
+//false and Read stays 0, so callers report the misses as unknown.
+class PerfCounter
+{
+  public:
+    PerfCounter() {;}
+
+    ~PerfCounter() {PerfCounter::Close();}
+
+    PerfCounter(const PerfCounter &) = delete;
+    PerfCounter & operator=(const PerfCounter &) = delete;
+
+    /* FUNCTIONS DEDICATED TO COUNTING */
+
+    //Will start counting on this thread, false if the kernel refused
+    bool Open()
+    {
+      PerfCounter::Close();
+
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+
+      mFd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+      return mFd >= 0;
+    }
+
+    //Will stop counting
+    void Close()
+    {
+      if(mFd >= 0)
+        close(mFd);
+      mFd = -1;
+    }
+
+    //Will return the misses counted since Open, 0 if it is not open
+    uint64_t Read() const
+    {
+      uint64_t count = 0;
+      if(mFd < 0 || read(mFd, &count, sizeof(count)) != sizeof(count))
+        return 0;
+      return count;
+    }
+
+    //Return if the counter is running
+    bool IsOpen() const {return mFd >= 0;}
+
+  private:
+    int mFd = -1;
+};
+
+#endif
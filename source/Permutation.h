@@ -0,0 +1,116 @@
+#ifndef HP_PERMUTATION_H
+#define HP_PERMUTATION_H
+
+#include <cstdint>
+#include <cstddef>
+
+/* CLASS USED TO SHUFFLE A RANGE OF NUMBERS WITHOUT STORING IT */
+
+//A keyed bijection of [0, size), so element i of a random ordering of the
+//range, and the position of any number in it, cost O(1) expected time and
+//no memory. A 4 round Feistel network shuffles the smallest even number of
+//bits that covers size, and numbers past size are walked forward until they
+//land inside it (cycle walking). That domain is under 4 * size, so a walk
+//takes fewer than 4 steps on average.
+class KeyedPermutation
+{
+  public:
+    KeyedPermutation() {;}
+
+    /* FUNCTIONS DEDICATED TO PICKING THE PERMUTATION */
+
+    //Will shuffle [0, size) with round keys drawn from rnd
+    template<typename RNG>
+    void Reset(uint64_t size, RNG & rnd)
+    {
+      size_t bits = 2;
+      while(bits < 64 && ((uint64_t) 1 << bits) < size)
+        bits += 2;
+
+      mSize = size;
+      mHalf = bits / 2;
+      mMask = ((uint64_t) 1 << mHalf) - 1;
+
+      for(size_t r = 0; r < ROUNDS; ++r)
+        mKeys[r] = rnd.GetUInt32();
+    }
+
+    /* FUNCTIONS DEDICATED TO MAPPING */
+
+    //Will return the number at position i, i < GetSize()
+    uint64_t Forward(uint64_t i) const
+    {
+      do
+        i = KeyedPermutation::Encrypt(i);
+      while(i >= mSize);
+
+      return i;
+    }
+
+    //Will return the position of number n, n < GetSize()
+    uint64_t Inverse(uint64_t n) const
+    {
+      do
+        n = KeyedPermutation::Decrypt(n);
+      while(n >= mSize);
+
+      return n;
+    }
+
+    //Return how many numbers are shuffled, 0 before Reset
+    uint64_t GetSize() const {return mSize;}
+
+  private:
+    //Will scramble the bits of x (murmur3 finalizer)
+    static uint32_t Mix(uint32_t x)
+    {
+      x ^= x >> 16;
+      x *= 0x85EBCA6B;
+      x ^= x >> 13;
+      x *= 0xC2B2AE35;
+      x ^= x >> 16;
+      return x;
+    }
+
+    //Will run the rounds forward on the 2 * mHalf bits of x
+    uint64_t Encrypt(uint64_t x) const
+    {
+      uint64_t left = x >> mHalf, right = x & mMask;
+
+      for(size_t r = 0; r < ROUNDS; ++r)
+      {
+        uint64_t next = left ^ (Mix((uint32_t) right ^ mKeys[r]) & mMask);
+        left = right;
+        right = next;
+      }
+
+      return (left << mHalf) | right;
+    }
+
+    //Will undo Encrypt
+    uint64_t Decrypt(uint64_t x) const
+    {
+      uint64_t left = x >> mHalf, right = x & mMask;
+
+      for(size_t r = ROUNDS; r-- > 0;)
+      {
+        uint64_t prev = right ^ (Mix((uint32_t) left ^ mKeys[r]) & mMask);
+        right = left;
+        left = prev;
+      }
+
+      return (left << mHalf) | right;
+    }
+
+    static constexpr size_t ROUNDS = 4;
+
+    //Numbers shuffled
+    uint64_t mSize = 0;
+    //Bits in each half of the Feistel network, and their mask
+    size_t mHalf = 1;
+    uint64_t mMask = 1;
+    //One key per round
+    uint32_t mKeys[ROUNDS] = {0, 0, 0, 0};
+};
+
+#endif
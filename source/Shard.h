@@ -0,0 +1,506 @@
+#ifndef HP_SHARD_H
+#define HP_SHARD_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hp_config.h"
+#include "Graph.h"
+#include "Library.h"
+#include "Archive.h"
+#include "PackedGenome.h"
+#include "Experiment.h"
+
+/* CONSTEXPR FOR SHARDING */
+
+//Most memory entries one cross band broadcast can carry
+//Output memory is keyed by Output arguments, which a packed genome keeps in
+//[0, PACK_ARG_MAX], so every message fits whole
+constexpr size_t SHARD_MEM = PACK_ARG_MAX + 1;
+
+/* CLASS USED TO EVALUATE ONE GENOME ON A GRAPH SPLIT ACROSS PROCESSES */
+
+//The rows of the GRA_DIM x GRA_DIM grid are split into SHARD_PROCS bands and
+//every band is built and run by its own forked process, so no process holds
+//more than its band. The processes share one anonymous mapping:
+//  - a barrier ending every iteration
+//  - per band, per iteration parity: overrun flag and unanimous vote
+//  - per band, per parity, per side (up/down): a segment of boundary mail
+//  - per band: the final result and vote counts
+//Mail a band sends to a neighboring band in iteration i is written to the
+//segments of parity i % 2 and delivered at the start of iteration i + 1,
+//while iteration i + 1 writes the other parity. Consensus is the AND of the
+//bands being unanimous on the same vote, and the final legal vote counts,
+//vote broadcasts and mail sent of the bands are merged by the parent, which
+//scores them as Experiment::Adjust does.
+//
+//Differences from Graph::RunGraph: mail across a band edge arrives one
+//iteration late, mail past SHARD_MAIL_CAP per segment is dropped (and
+//counted), and the EVAL_* budgets apply to each band on its own.
+class Shard
+{
+  public:
+    Shard(const HPConfig & config) :
+    mConfig(config), GRA_DIM(config.GRA_DIM()), GRA_TYPE(config.GRA_TYPE()),
+    NUM_ITER(config.NUM_ITER()), OVERRUN_SCORE(config.OVERRUN_SCORE()),
+    SHARD_PROCS(std::max<size_t>(1, std::min<size_t>(config.SHARD_PROCS(), config.GRA_DIM()))),
+    SHARD_MAIL_CAP(std::max<size_t>(1, config.SHARD_MAIL_CAP()))
+    {
+      mLib = emp::NewPtr<Library>(config);
+      Shard::Map();
+    }
+
+    ~Shard()
+    {
+      if(mShared != MAP_FAILED)
+        munmap(mShared, mBytes);
+      mLib.Delete();
+    }
+
+    /* FUNCTIONS DEDICATED TO EVALUATING */
+
+    //Will evaluate pro with the random streams of (gen, agent), false if a worker failed
+    bool Evaluate(program_t & pro, size_t gen = 0, size_t agent = 0);
+
+    //Will evaluate the best archived agent of the last snapshot at or before gen
+    bool EvaluateArchive(size_t gen, std::ostream & os = std::cout);
+
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return score of the last evaluation
+    double GetScore() const {return mScore;}
+
+    //Return number of legal votes broadcast in the last evaluation
+    double GetVoteCount() const {return mVoteCount;}
+
+    //Return number of boundary broadcasts dropped in the last evaluation
+    size_t GetDropped() const {return mDropped;}
+
+    //Return if a band passed its budget in the last evaluation
+    bool IsOverrun() const {return mOverrun;}
+
+  private:
+    //Boundary broadcast in shared memory
+    struct Mail
+    {
+      uint32_t mX, mY, mTag, mSize;
+      int32_t mKeys[SHARD_MEM];
+      double mVals[SHARD_MEM];
+    };
+
+    //Mail one band sends to one neighbor in one iteration
+    struct Segment
+    {
+      uint64_t mCount;
+      Mail mMail[1];
+    };
+
+    //What a band tells the others at the end of an iteration
+    struct Stats
+    {
+      uint32_t mOverrun;
+      uint32_t mUnanimous;
+      double mVote;
+    };
+
+    //What a band hands back to the parent
+    struct Result
+    {
+      uint32_t mOverrun;
+      double mConsensus;
+      double mVoteCount;
+      uint64_t mDropped;
+      uint64_t mSent;
+      uint64_t mVotes;
+    };
+
+    /* HELPERS FOR THE SHARED MAPPING */
+
+    //Will lay out and map the shared memory
+    void Map();
+
+    static size_t Align(size_t n) {return (n + 63) & ~(size_t) 63;}
+
+    pthread_barrier_t * GetBarrier() {return (pthread_barrier_t *) mShared;}
+    Stats & GetStats(size_t parity, size_t w) {return ((Stats *) (mBase + mStatsOff))[parity * SHARD_PROCS + w];}
+    Result & GetResult(size_t w) {return ((Result *) (mBase + mResultOff))[w];}
+    Segment & GetSegment(size_t parity, size_t w, size_t side)
+    {
+      return *(Segment *) (mBase + mSegmentOff + ((parity * SHARD_PROCS + w) * 2 + side) * mSegmentBytes);
+    }
+    double * GetVotes(size_t w) {return (double *) (mBase + mVotesOff) + w * 2 * mBandMax;}
+
+    //First row of band w
+    size_t Begin(size_t w) const {return w * GRA_DIM / SHARD_PROCS;}
+
+    //Band holding row x
+    size_t Owner(size_t x) const
+    {
+      size_t w = x * SHARD_PROCS / GRA_DIM;
+      while(Begin(w + 1) <= x)
+        ++w;
+      while(Begin(w) > x)
+        --w;
+      return w;
+    }
+
+    /* FUNCTIONS RUN BY THE WORKERS */
+
+    //Will run band w, only returns inside the forked child
+    void Worker(size_t w, program_t & pro, size_t gen, size_t agent);
+
+    //Will write mail for (x, y) into the segment toward its band
+    bool Export(size_t w, size_t x, size_t y, const memory_t & msg, const affinity_t & affinity);
+
+    //Will deliver the mail segment (parity, src, side) into graph
+    void Import(Graph & graph, size_t parity, size_t src, size_t side);
+
+    //Config every band builds its graph from
+    const HPConfig & mConfig;
+    //Dimension of the graph
+    size_t GRA_DIM;
+    //Graph type
+    size_t GRA_TYPE;
+    //All the iterations
+    size_t NUM_ITER;
+    //Score given to an evaluation that passed a limit
+    double OVERRUN_SCORE;
+    //Number of bands
+    size_t SHARD_PROCS;
+    //Mail per segment
+    size_t SHARD_MAIL_CAP;
+    //Instruction and event libraries, inherited by every worker
+    emp::Ptr<Library> mLib;
+
+    //Shared mapping and its layout
+    void * mShared = MAP_FAILED;
+    uint8_t * mBase = nullptr;
+    size_t mBytes = 0;
+    size_t mStatsOff = 0;
+    size_t mResultOff = 0;
+    size_t mSegmentOff = 0;
+    size_t mSegmentBytes = 0;
+    size_t mVotesOff = 0;
+    //Most nodes in one band
+    size_t mBandMax = 0;
+
+    //Worker side state
+    size_t mParity = 0;
+    size_t mWorkerDropped = 0;
+
+    //Results of the last evaluation
+    double mScore = 0.0;
+    double mVoteCount = 0.0;
+    size_t mDropped = 0;
+    bool mOverrun = false;
+};
+
+/* HELPERS FOR THE SHARED MAPPING */
+
+//Will lay out and map the shared memory
+void Shard::Map()
+{
+  mBandMax = ((GRA_DIM + SHARD_PROCS - 1) / SHARD_PROCS) * GRA_DIM;
+  mSegmentBytes = Align(sizeof(Segment) + (SHARD_MAIL_CAP - 1) * sizeof(Mail));
+
+  mStatsOff = Align(sizeof(pthread_barrier_t));
+  mResultOff = mStatsOff + Align(2 * SHARD_PROCS * sizeof(Stats));
+  mSegmentOff = mResultOff + Align(SHARD_PROCS * sizeof(Result));
+  mVotesOff = mSegmentOff + 2 * SHARD_PROCS * 2 * mSegmentBytes;
+  mBytes = mVotesOff + SHARD_PROCS * 2 * mBandMax * sizeof(double);
+
+  mShared = mmap(nullptr, mBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(mShared == MAP_FAILED)
+  {
+    std::cout << "Shard could not map " << mBytes << " bytes of shared memory. Exiting..." << std::endl;
+    exit(-1);
+  }
+
+  mBase = (uint8_t *) mShared;
+}
+
+/* FUNCTIONS DEDICATED TO EVALUATING */
+
+//Will evaluate pro with the random streams of (gen, agent), false if a worker failed
+bool Shard::Evaluate(program_t & pro, size_t gen, size_t agent)
+{
+  //Checked before any band is forked, a band would stop in ConfigureTraits
+  if(!Graph::CheckUIDs(mConfig, GRA_DIM, std::cout))
+    return false;
+
+  pthread_barrierattr_t attr;
+  pthread_barrierattr_init(&attr);
+  pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_barrier_init(Shard::GetBarrier(), &attr, SHARD_PROCS);
+  pthread_barrierattr_destroy(&attr);
+
+  std::memset(mBase + mResultOff, 0, SHARD_PROCS * sizeof(Result));
+
+  //Children must not flush what the parent already buffered
+  std::cout.flush();
+
+  std::vector<pid_t> pids;
+  bool ok = true;
+
+  for(size_t w = 0; w < SHARD_PROCS; ++w)
+  {
+    pid_t pid = fork();
+
+    if(pid == 0)
+    {
+      Shard::Worker(w, pro, gen, agent);
+      std::cout.flush();
+      _exit(0);
+    }
+
+    if(pid < 0)
+    {
+      std::cout << "Shard could not fork band " << w << "." << std::endl;
+      ok = false;
+      break;
+    }
+
+    pids.push_back(pid);
+  }
+
+  //A band that is missing or dies leaves the others waiting on the barrier
+  std::vector<pid_t> running = pids;
+  if(!ok)
+  {
+    for(pid_t p : running)
+      kill(p, SIGKILL);
+  }
+
+  while(!running.empty())
+  {
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, 0);
+
+    if(pid <= 0)
+      break;
+
+    auto it = std::find(running.begin(), running.end(), pid);
+    if(it == running.end())
+      continue;
+    running.erase(it);
+
+    if(ok && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+    {
+      ok = false;
+      for(pid_t p : running)
+        kill(p, SIGKILL);
+    }
+  }
+
+  pthread_barrier_destroy(Shard::GetBarrier());
+
+  if(!ok)
+  {
+    std::cout << "Shard evaluation failed." << std::endl;
+    return false;
+  }
+
+  //Merge the bands
+  std::unordered_map<double, double> votes;
+  size_t sent = 0;
+  mVoteCount = 0.0;
+  mDropped = 0;
+  mOverrun = false;
+
+  for(size_t w = 0; w < SHARD_PROCS; ++w)
+  {
+    Result & res = Shard::GetResult(w);
+    mOverrun = mOverrun || res.mOverrun;
+    mVoteCount += res.mVoteCount;
+    mDropped += res.mDropped;
+    sent += res.mSent;
+
+    double * pairs = Shard::GetVotes(w);
+    for(size_t k = 0; k < res.mVotes; ++k)
+      votes[pairs[2 * k]] += pairs[2 * k + 1];
+  }
+
+  if(mOverrun)
+  {
+    mScore = OVERRUN_SCORE;
+    return true;
+  }
+
+  //Every band sums the same consensus, so band 0 speaks for all
+  double legal = 0.0, largest = 0.0;
+  for(auto & p : votes)
+  {
+    legal += p.second;
+    largest = std::max(largest, p.second);
+  }
+
+  mScore = Shard::GetResult(0).mConsensus + legal + largest;
+  mScore = Experiment::Adjust(mScore, mVoteCount, sent, GRA_DIM * GRA_DIM, mConfig.TRAFFIC_COST());
+  return true;
+}
+
+//Will evaluate the best archived agent of the last snapshot at or before gen
+bool Shard::EvaluateArchive(size_t gen, std::ostream & os)
+{
+  std::vector<Elite> elites;
+
+  if(!Archive::Read(mConfig.ARCHIVE_FILE(), gen, elites) || elites.empty())
+    return false;
+
+  program_t pro(mLib->GetInstLib());
+  elites[0].mGenome.Unpack(pro);
+
+  if(!Shard::Evaluate(pro, gen))
+    return false;
+
+  os << "GEN: " << gen << " DIM: " << GRA_DIM << " BANDS: " << SHARD_PROCS
+     << " Score: " << mScore << " THEORY_MAX: " << NUM_ITER * GRA_DIM * GRA_DIM + 1
+     << " VOTES: " << mVoteCount << " DROPPED: " << mDropped
+     << (mOverrun ? " OVERRUN" : "") << std::endl;
+
+  return true;
+}
+
+/* FUNCTIONS RUN BY THE WORKERS */
+
+//Will run band w, only returns inside the forked child
+void Shard::Worker(size_t w, program_t & pro, size_t gen, size_t agent)
+{
+  Graph graph(mConfig);
+  graph.SetBand(Shard::Begin(w), Shard::Begin(w + 1), [this, w](size_t x, size_t y, const memory_t & msg, const affinity_t & affinity)
+  {
+    return this->Export(w, x, y, msg, affinity);
+  });
+
+  graph.CreateGraph(GRA_DIM, GRA_TYPE, mLib->GetInstLib(), mLib->GetEventLib());
+  graph.CreateAdjList(GRA_TYPE, GRA_DIM);
+  graph.SetStream(gen, agent);
+  graph.Reset();
+  //Schedule draws of every band come from their own trial
+  graph.SetStream(gen, agent, 1 + w);
+  graph.SetGenome(pro);
+
+  Result & res = Shard::GetResult(w);
+  size_t up = (w + SHARD_PROCS - 1) % SHARD_PROCS;
+  size_t down = (w + 1) % SHARD_PROCS;
+  mWorkerDropped = 0;
+
+  for(size_t i = 0; i < NUM_ITER; ++i)
+  {
+    mParity = i % 2;
+    Shard::GetSegment(mParity, w, 0).mCount = 0;
+    Shard::GetSegment(mParity, w, 1).mCount = 0;
+
+    //Mail the neighbors sent toward this band last iteration
+    if(i > 0)
+    {
+      Shard::Import(graph, 1 - mParity, up, 1);
+      Shard::Import(graph, 1 - mParity, down, 0);
+    }
+
+    Stats & stats = Shard::GetStats(mParity, w);
+    stats.mOverrun = !graph.RunIteration();
+    graph.CountVotes();
+    stats.mUnanimous = graph.Unanimous(stats.mVote);
+
+    pthread_barrier_wait(Shard::GetBarrier());
+
+    bool overrun = false, agree = true;
+    for(size_t v = 0; v < SHARD_PROCS; ++v)
+    {
+      Stats & s = Shard::GetStats(mParity, v);
+      overrun = overrun || s.mOverrun;
+      agree = agree && s.mUnanimous && s.mVote == Shard::GetStats(mParity, 0).mVote;
+    }
+
+    if(overrun)
+    {
+      res.mOverrun = 1;
+      break;
+    }
+
+    if(agree)
+      res.mConsensus += GRA_DIM * GRA_DIM;
+  }
+
+  graph.MakeFinalVotes();
+  double * pairs = Shard::GetVotes(w);
+  size_t k = 0;
+  for(auto & p : graph.GetFinVotes())
+  {
+    pairs[2 * k] = p.first;
+    pairs[2 * k + 1] = p.second;
+    ++k;
+  }
+
+  res.mVotes = k;
+  res.mVoteCount = graph.GetVoteCount();
+  res.mDropped = mWorkerDropped;
+  res.mSent = graph.GetTraffic().mSent;
+}
+
+//Will write mail for (x, y) into the segment toward its band
+//A full segment drops the mail but lets the broadcast go on
+bool Shard::Export(size_t w, size_t x, size_t y, const memory_t & msg, const affinity_t & affinity)
+{
+  size_t side = (Shard::Owner(x) == (w + 1) % SHARD_PROCS) ? 1 : 0;
+  Segment & seg = Shard::GetSegment(mParity, w, side);
+
+  if(seg.mCount == SHARD_MAIL_CAP)
+  {
+    ++mWorkerDropped;
+    return true;
+  }
+
+  Mail & mail = seg.mMail[seg.mCount++];
+  mail.mX = x;
+  mail.mY = y;
+  mail.mTag = affinity.GetUInt(0);
+  mail.mSize = 0;
+
+  for(auto & p : msg)
+  {
+    emp_assert(mail.mSize < SHARD_MEM);
+    if(mail.mSize == SHARD_MEM)
+      break;
+
+    mail.mKeys[mail.mSize] = p.first;
+    mail.mVals[mail.mSize] = p.second;
+    ++mail.mSize;
+  }
+
+  return true;
+}
+
+//Will deliver the mail segment (parity, src, side) into graph
+void Shard::Import(Graph & graph, size_t parity, size_t src, size_t side)
+{
+  Segment & seg = Shard::GetSegment(parity, src, side);
+  memory_t msg;
+  affinity_t affinity;
+
+  for(size_t m = 0; m < seg.mCount; ++m)
+  {
+    const Mail & mail = seg.mMail[m];
+    msg.clear();
+    for(size_t k = 0; k < mail.mSize; ++k)
+      msg[mail.mKeys[k]] = mail.mVals[k];
+
+    affinity.SetUInt(0, mail.mTag);
+    graph.Receive(mail.mX, mail.mY, msg, affinity);
+  }
+}
+
+#endif
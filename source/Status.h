@@ -0,0 +1,235 @@
+#ifndef HP_STATUS_H
+#define HP_STATUS_H
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* CLASS USED TO PUBLISH LIVE RUN METRICS IN A MAPPED FILE */
+
+//The running experiment maps STATUS_FILE and rewrites one fixed size record
+//at the end of every generation, so the hot loop never blocks on a reader
+//and no socket or thread is needed. Readers map the same file read only
+//(main --status <file>). The record is guarded by a sequence number, odd
+//while a write is in progress: a reader copies the record and keeps the copy
+//only if the sequence was even and did not change around the copy.
+class Status
+{
+  public:
+    //Everything published, one generation at a time
+    struct Record
+    {
+      char mMagic[4];
+      uint32_t mPid;
+      //Generation just finished and generations in the run
+      uint64_t mGen;
+      uint64_t mNumGens;
+      //Unix time of the update in ms, and seconds since the run started
+      uint64_t mUpdated;
+      double mElapsed;
+      //Rates over the whole run and over the last generation
+      double mGensPerSec;
+      double mEvalsPerSec;
+      double mLastEvalsPerSec;
+      //Evaluations of the last generation and the share skipped as inert
+      uint64_t mEvals;
+      double mSkipRate;
+      //Share of the last generation spent evaluating
+      double mEvalShare;
+      //Share of the population the screen promoted to the full graph (1 = no screen)
+      double mPromoteRate;
+      //Evaluations that passed a budget in the last generation
+      uint64_t mOverruns;
+      //Snapshots waiting for the archive writer
+      uint64_t mArchiveQueue;
+      //Evaluation threads or worker processes, and workers restarted last generation
+      uint64_t mWorkers;
+      uint64_t mRestarts;
+      //Scores of the last generation
+      double mBest;
+      double mMean;
+      double mTheoryMax;
+    };
+
+    Status() {;}
+
+    ~Status() {Status::Close();}
+
+    /* FUNCTIONS DEDICATED TO PUBLISHING */
+
+    //Will create (or truncate) fname and map it
+    bool Open(const std::string & fname);
+
+    //Will unmap the file, which stays on disk with the last record
+    void Close();
+
+    //Will publish rec
+    void Publish(const Record & rec);
+
+    //Return if a file is mapped
+    bool IsOpen() const {return mMap != nullptr;}
+
+
+    /* FUNCTIONS DEDICATED TO READING */
+
+    //Will copy the record in fname into rec, false if there is none
+    static bool Read(const std::string & fname, Record & rec);
+
+    //Will print the record in fname
+    static bool Print(const std::string & fname, std::ostream & os = std::cout);
+
+  private:
+    //What is mapped: the sequence number, then the record
+    struct Shared
+    {
+      std::atomic<uint64_t> mSeq;
+      Record mRecord;
+    };
+
+    Shared & GetShared() {return *(Shared *) mMap;}
+
+    void * mMap = nullptr;
+};
+
+/* FUNCTIONS DEDICATED TO PUBLISHING */
+
+//Will create (or truncate) fname and map it
+bool Status::Open(const std::string & fname)
+{
+  Status::Close();
+
+  int fd = open(fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0 || ftruncate(fd, sizeof(Shared)) != 0)
+  {
+    std::cout << "Failed to open status file(" << fname << ")." << std::endl;
+    if(fd >= 0)
+      close(fd);
+    return false;
+  }
+
+  void * map = mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if(map == MAP_FAILED)
+  {
+    std::cout << "Failed to map status file(" << fname << ")." << std::endl;
+    return false;
+  }
+
+  mMap = map;
+  new (mMap) Shared();
+  return true;
+}
+
+//Will unmap the file, which stays on disk with the last record
+void Status::Close()
+{
+  if(mMap)
+    munmap(mMap, sizeof(Shared));
+  mMap = nullptr;
+}
+
+//Will publish rec
+void Status::Publish(const Record & rec)
+{
+  if(!mMap)
+    return;
+
+  Shared & shared = Status::GetShared();
+  uint64_t seq = shared.mSeq.load(std::memory_order_relaxed);
+
+  shared.mSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&shared.mRecord, &rec, sizeof(Record));
+  std::memcpy(shared.mRecord.mMagic, "HPS1", 4);
+  shared.mSeq.store(seq + 2, std::memory_order_release);
+}
+
+/* FUNCTIONS DEDICATED TO READING */
+
+//Will copy the record in fname into rec, false if there is none
+bool Status::Read(const std::string & fname, Record & rec)
+{
+  int fd = open(fname.c_str(), O_RDONLY);
+  if(fd < 0)
+  {
+    std::cout << "Failed to open status file(" << fname << ")." << std::endl;
+    return false;
+  }
+
+  void * map = mmap(nullptr, sizeof(Shared), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if(map == MAP_FAILED)
+  {
+    std::cout << fname << " is not a status file." << std::endl;
+    return false;
+  }
+
+  const Shared & shared = *(const Shared *) map;
+  bool read = false;
+
+  //A write takes well under a millisecond, so a few tries always get through
+  for(size_t tries = 0; tries < 1000 && !read; ++tries)
+  {
+    uint64_t before = shared.mSeq.load(std::memory_order_acquire);
+    if(before & 1)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::memcpy(&rec, &shared.mRecord, sizeof(Record));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    read = (before != 0) && shared.mSeq.load(std::memory_order_relaxed) == before;
+  }
+
+  munmap(map, sizeof(Shared));
+
+  if(!read || std::memcmp(rec.mMagic, "HPS1", 4) != 0)
+  {
+    std::cout << "No status in " << fname << " yet." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+//Will print the record in fname
+bool Status::Print(const std::string & fname, std::ostream & os)
+{
+  Record rec;
+  if(!Status::Read(fname, rec))
+    return false;
+
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+  os << "pid:           " << rec.mPid << std::endl;
+  os << "generation:    " << rec.mGen << "/" << rec.mNumGens << std::endl;
+  os << "updated:       " << ((uint64_t) now - rec.mUpdated) / 1000.0 << "s ago" << std::endl;
+  os << "elapsed:       " << rec.mElapsed << "s" << std::endl;
+  os << "gens/sec:      " << rec.mGensPerSec << std::endl;
+  os << "evals/sec:     " << rec.mEvalsPerSec << " (last gen " << rec.mLastEvalsPerSec << ")" << std::endl;
+  os << "evals:         " << rec.mEvals << std::endl;
+  os << "skip rate:     " << rec.mSkipRate << std::endl;
+  os << "promote rate:  " << rec.mPromoteRate << std::endl;
+  os << "eval share:    " << rec.mEvalShare << std::endl;
+  os << "overruns:      " << rec.mOverruns << std::endl;
+  os << "archive queue: " << rec.mArchiveQueue << std::endl;
+  os << "workers:       " << rec.mWorkers << " (restarted " << rec.mRestarts << ")" << std::endl;
+  os << "best:          " << rec.mBest << " (THEORY_MAX " << rec.mTheoryMax << ")" << std::endl;
+  os << "mean:          " << rec.mMean << std::endl;
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef HP_STREAMRANDOM_H
+#define HP_STREAMRANDOM_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+/* WHAT A STREAM IS USED FOR, KEEPS STREAMS WITH THE SAME IDS APART */
+enum StreamPurpose : uint32_t
+{
+  STREAM_GRAPH = 1,   //UID draws, schedule shuffles and hardware seeds of one evaluation
+  STREAM_SELECT,      //Tournament draws of one offspring, or of the enemies and deck of one generation
+  STREAM_MUTATE       //Mutations of one offspring
+};
+
+/* COUNTER BASED RANDOM NUMBER GENERATOR (PHILOX 4x32-10) */
+
+//Every (purpose, generation, agent, trial) names its own stream.
+//The n-th number of a stream is Philox(key = {seed, purpose},
+//counter = {n / 4, trial, agent, generation}), so a stream can be
+//recreated anywhere without sharing generator state.
+class StreamRandom
+{
+  public:
+    StreamRandom(uint32_t seed = 0, uint32_t purpose = STREAM_GRAPH) : mKey{seed, purpose} {;}
+
+    /* FUNCTIONS DEDICATED TO PICKING THE STREAM */
+
+    //Will jump to the start of stream (generation, agent, trial)
+    void SetStream(uint32_t gen, uint32_t agent, uint32_t trial = 0)
+    {
+      mCounter[0] = 0;
+      mCounter[1] = trial;
+      mCounter[2] = agent;
+      mCounter[3] = gen;
+      mNext = 4;
+    }
+
+    /* FUNCTIONS DEDICATED TO DRAWING NUMBERS */
+
+    //Will return 32 random bits
+    uint32_t GetUInt32()
+    {
+      if(mNext == 4)
+      {
+        Philox(mCounter, mKey, mBlock);
+        mCounter[0] += 1;
+        mNext = 0;
+      }
+
+      return mBlock[mNext++];
+    }
+
+    //Will return a number in [0, max)
+    uint32_t GetUInt(uint32_t max) {return ((uint64_t) GetUInt32() * max) >> 32;}
+
+    //Will return a number in [min, max)
+    uint32_t GetUInt(uint32_t min, uint32_t max) {return min + GetUInt(max - min);}
+
+    //Will return a number in [0, 1)
+    double GetDouble()
+    {
+      uint64_t bits = ((uint64_t) GetUInt32() << 21) ^ GetUInt32();
+      return (bits & ((1ull << 53) - 1)) * (1.0 / (1ull << 53));
+    }
+
+    //Will return true with probability p
+    bool P(double p) {return GetDouble() < p;}
+
+    //Will return a positive seed for an emp::Random driven by this stream
+    int GetSeed() {return 1 + (GetUInt32() & 0x7FFFFFFE);}
+
+    //Will shuffle v in place (Fisher-Yates)
+    template<typename T>
+    void Shuffle(std::vector<T> & v)
+    {
+      for(size_t i = v.size(); i > 1; --i)
+      {
+        std::swap(v[i - 1], v[GetUInt(i)]);
+      }
+    }
+
+  private:
+    //Will encrypt ctr under key into out with 10 Philox rounds
+    static void Philox(const uint32_t * ctr, const uint32_t * key, uint32_t * out)
+    {
+      uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+      uint32_t k0 = key[0], k1 = key[1];
+
+      for(size_t r = 0; r < 10; ++r)
+      {
+        uint64_t p0 = (uint64_t) 0xD2511F53 * c0;
+        uint64_t p1 = (uint64_t) 0xCD9E8D57 * c2;
+
+        c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t) p1;
+        c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t) p0;
+
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+      }
+
+      out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    //Seed and purpose
+    uint32_t mKey[2];
+    //Block index, trial, agent and generation
+    uint32_t mCounter[4] = {0, 0, 0, 0};
+    //Last block of output
+    uint32_t mBlock[4] = {0, 0, 0, 0};
+    //Next unused word of mBlock
+    size_t mNext = 4;
+};
+
+#endif
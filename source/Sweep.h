@@ -0,0 +1,217 @@
+#ifndef HP_SWEEP_H
+#define HP_SWEEP_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hp_config.h"
+#include "Library.h"
+#include "Experiment.h"
+#include "ThreadPool.h"
+
+/* CLASS USED TO RUN A MATRIX OF CONFIGS IN ONE PROCESS */
+
+//The matrix file has the names of the settings to change on its first line,
+//then one line of values per experiment, e.g.
+//  GRA_DIM NUM_ITER TOURN_SIZE
+//  3       128      2
+//  5       256      4
+//Lines starting with # are skipped. Every row starts from the base config
+//file. All rows share one Library and one ThreadPool; experiment i logs to
+//sweep_<i>.log, archives to <ARCHIVE_FILE>_<i>, writes its lineage to
+//<i>_<LINEAGE_FILE>, its traces to <TRACE_FILE>_<i>_<gen>.hpt, its live
+//metrics to <STATUS_FILE>_<i> and the best score of every generation is merged into
+//one CSV table. Rows are checked like the base config, see Experiment::CheckConfig,
+//and must not use a farm. A row breeds on one thread unless it sets REPRO_THREADS.
+class Sweep
+{
+  public:
+    Sweep(const std::string & config_fname, const std::string & matrix_fname, size_t threads) :
+    mConfigFile(config_fname), mMatrixFile(matrix_fname), mThreads(threads)
+    {;}
+
+    ~Sweep()
+    {
+      for(auto e : mExperiments)
+        e.Delete();
+      for(auto c : mConfigs)
+        c.Delete();
+      if(mLib)
+        mLib.Delete();
+    }
+
+    //Will run every row of the matrix, writing the merged table to os
+    bool Run(std::ostream & os = std::cout);
+
+  private:
+    //Will read mNames and mRows from the matrix file
+    bool ReadMatrix();
+
+    //Base config file and matrix file
+    std::string mConfigFile;
+    std::string mMatrixFile;
+    //Number of experiments run at once
+    size_t mThreads;
+    //Settings changed by the matrix
+    std::vector<std::string> mNames;
+    //Values of each row
+    std::vector<std::vector<std::string>> mRows;
+    //One config and experiment per row
+    std::vector<emp::Ptr<HPConfig>> mConfigs;
+    std::vector<emp::Ptr<Experiment>> mExperiments;
+    //Libraries shared by every experiment
+    emp::Ptr<Library> mLib = nullptr;
+};
+
+//Will read mNames and mRows from the matrix file
+bool Sweep::ReadMatrix()
+{
+  std::ifstream in(mMatrixFile);
+
+  if(!in.is_open())
+  {
+    std::cout << "Failed to open sweep matrix file(" << mMatrixFile << ")." << std::endl;
+    return false;
+  }
+
+  std::string line;
+  while(std::getline(in, line))
+  {
+    std::stringstream ss(line);
+    std::vector<std::string> words;
+    std::string word;
+
+    while(ss >> word)
+      words.push_back(word);
+
+    if(words.empty() || words[0][0] == '#')
+      continue;
+
+    if(mNames.empty())
+    {
+      mNames = words;
+      continue;
+    }
+
+    if(words.size() != mNames.size())
+    {
+      std::cout << "Sweep row has " << words.size() << " values for " << mNames.size() << " settings: " << line << std::endl;
+      return false;
+    }
+
+    mRows.push_back(words);
+  }
+
+  return !mRows.empty();
+}
+
+//Will run every row of the matrix, writing the merged table to os
+bool Sweep::Run(std::ostream & os)
+{
+  if(!Sweep::ReadMatrix())
+    return false;
+
+  for(size_t r = 0; r < mRows.size(); ++r)
+  {
+    emp::Ptr<HPConfig> config = emp::NewPtr<HPConfig>();
+    config->Read(mConfigFile);
+
+    for(size_t k = 0; k < mNames.size(); ++k)
+    {
+      if(!config->Has(mNames[k]))
+      {
+        std::cout << "Sweep setting " << mNames[k] << " is unknown." << std::endl;
+        config.Delete();
+        return false;
+      }
+
+      config->Set(mNames[k], mRows[r][k]);
+    }
+
+    //Rows must not share an archive
+    config->Set("ARCHIVE_FILE", config->ARCHIVE_FILE() + "_" + std::to_string(r));
+    config->Set("LINEAGE_FILE", std::to_string(r) + "_" + config->LINEAGE_FILE());
+    if(!config->TRACE_FILE().empty())
+      config->Set("TRACE_FILE", config->TRACE_FILE() + "_" + std::to_string(r));
+    if(!config->STATUS_FILE().empty())
+      config->Set("STATUS_FILE", config->STATUS_FILE() + "_" + std::to_string(r));
+
+    //Rows already run side by side, one breeder per core each would oversubscribe
+    if(config->REPRO_THREADS() == 0)
+      config->Set("REPRO_THREADS", "1");
+
+    mConfigs.push_back(config);
+  }
+
+  //Trait positions are baked into the instructions, so they must not vary
+  mLib = emp::NewPtr<Library>(*mConfigs[0]);
+  for(size_t r = 0; r < mConfigs.size(); ++r)
+  {
+    emp::Ptr<HPConfig> config = mConfigs[r];
+
+    if(!Experiment::CheckConfig(*config, std::cout))
+    {
+      std::cout << "Sweep row " << r << " can not run." << std::endl;
+      return false;
+    }
+
+    if(!mLib->Matches(*config))
+    {
+      std::cout << "Sweep rows must not change UID, VOTE, POSX or POSY." << std::endl;
+      return false;
+    }
+
+    //Worker processes would be forked from a process already running other rows
+    if(config->FARM_PROCS() > 0)
+    {
+      std::cout << "Sweep rows must not set FARM_PROCS, sweep row " << r << " does." << std::endl;
+      return false;
+    }
+  }
+
+  //Only built once every row is known to run
+  for(auto config : mConfigs)
+    mExperiments.push_back(emp::NewPtr<Experiment>(*config, mLib));
+
+  std::vector<std::ofstream> logs(mExperiments.size());
+
+  {
+    ThreadPool pool(mThreads);
+
+    for(size_t r = 0; r < mExperiments.size(); ++r)
+    {
+      logs[r].open("sweep_" + std::to_string(r) + ".log");
+      mExperiments[r]->SetOutput(logs[r]);
+
+      emp::Ptr<Experiment> e = mExperiments[r];
+      pool.Push([e]() {e->Run();});
+    }
+
+    pool.Wait();
+  }
+
+  os << "row";
+  for(auto & name : mNames)
+    os << "," << name;
+  os << ",gen,best" << std::endl;
+
+  for(size_t r = 0; r < mExperiments.size(); ++r)
+  {
+    const auto & best = mExperiments[r]->GetBestScores();
+
+    for(size_t g = 0; g < best.size(); ++g)
+    {
+      os << r;
+      for(auto & value : mRows[r])
+        os << "," << value;
+      os << "," << g << "," << best[g] << std::endl;
+    }
+  }
+
+  return true;
+}
+
+#endif
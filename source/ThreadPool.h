@@ -0,0 +1,111 @@
+#ifndef HP_THREADPOOL_H
+#define HP_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/* CLASS USED TO RUN TASKS ON A FIXED SET OF THREADS */
+class ThreadPool
+{
+  public:
+    using task_t = std::function<void()>;
+
+    ThreadPool(size_t threads)
+    {
+      if(threads == 0)
+        threads = 1;
+
+      for(size_t i = 0; i < threads; ++i)
+      {
+        mThreads.emplace_back([this]() {this->Work();});
+      }
+    }
+
+    //Will finish every task already pushed, then stop the threads
+    ~ThreadPool()
+    {
+      {
+        std::unique_lock<std::mutex> lock(mLock);
+        mStop = true;
+      }
+
+      mWake.notify_all();
+      for(auto & t : mThreads)
+        t.join();
+    }
+
+    /* FUNCTIONS DEDICATED TO RUNNING TASKS */
+
+    //Will queue a task for the next free thread
+    void Push(task_t task)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mLock);
+        mTasks.push_back(std::move(task));
+      }
+
+      mWake.notify_one();
+    }
+
+    //Will block until every pushed task is done
+    void Wait()
+    {
+      std::unique_lock<std::mutex> lock(mLock);
+      mDone.wait(lock, [this]() {return mTasks.empty() && mBusy == 0;});
+    }
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return number of threads
+    size_t GetSize() const {return mThreads.size();}
+
+  private:
+    //Loop run by every thread
+    void Work()
+    {
+      while(true)
+      {
+        task_t task;
+
+        {
+          std::unique_lock<std::mutex> lock(mLock);
+          mWake.wait(lock, [this]() {return mStop || !mTasks.empty();});
+
+          if(mTasks.empty())
+            return;
+
+          task = std::move(mTasks.front());
+          mTasks.pop_front();
+          ++mBusy;
+        }
+
+        task();
+
+        {
+          std::unique_lock<std::mutex> lock(mLock);
+          --mBusy;
+        }
+
+        mDone.notify_all();
+      }
+    }
+
+    //Worker threads
+    std::vector<std::thread> mThreads;
+    //Tasks waiting for a thread
+    std::deque<task_t> mTasks;
+    //Guards everything below
+    std::mutex mLock;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    //Number of tasks running right now
+    size_t mBusy = 0;
+    //Set when the pool is shutting down
+    bool mStop = false;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef HP_TIMINGWHEEL_H
+#define HP_TIMINGWHEEL_H
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include "../../Empirical/source/base/assert.h"
+
+/* CLASS USED TO HOLD ITEMS UNTIL A LATER TICK */
+
+//Hierarchical timing wheel: LEVELS wheels of SLOTS slots, level l covering
+//delays up to SLOTS^(l+1). An item goes into the lowest level whose range
+//still tells its tick apart from now, and is cascaded one level down each
+//time the level below wraps around, so Insert and Advance are O(1) per item.
+//Entries live in one pool and slots are singly linked lists through it.
+template<typename T>
+class TimingWheel
+{
+  public:
+    //Bits per level
+    static constexpr size_t BITS = 6;
+    static constexpr size_t SLOTS = 1 << BITS;
+    static constexpr size_t LEVELS = 4;
+    //Longest delay, the top level is kept free so it never wraps onto itself
+    static constexpr size_t MAX_DELAY = (1 << (BITS * (LEVELS - 1))) - 1;
+
+    TimingWheel() {Clear();}
+
+    /* FUNCTIONS DEDICATED TO THE WHEEL */
+
+    //Will drop every item and go back to tick 0
+    void Clear()
+    {
+      mEntries.clear();
+      mFree.clear();
+      mNow = 0;
+      mSize = 0;
+
+      for(size_t l = 0; l < LEVELS; ++l)
+        for(size_t s = 0; s < SLOTS; ++s)
+          mHeads[l][s] = NONE;
+    }
+
+    //Will hand item back delay ticks from now, delay is at least 1
+    void Insert(size_t delay, const T & item)
+    {
+      if(delay < 1)
+        delay = 1;
+      if(delay > MAX_DELAY)
+        delay = MAX_DELAY;
+
+      uint32_t e;
+      if(mFree.empty())
+      {
+        e = mEntries.size();
+        mEntries.emplace_back();
+      }
+
+      else
+      {
+        e = mFree.back();
+        mFree.pop_back();
+      }
+
+      mEntries[e].mExpire = mNow + delay;
+      mEntries[e].mItem = item;
+      TimingWheel::Place(e);
+      ++mSize;
+    }
+
+    //Will move to the next tick and call fun on every item due at it
+    template<typename FUN>
+    void Advance(FUN && fun)
+    {
+      ++mNow;
+
+      //Highest level first, so what it cascades into a lower slot due now is cascaded again
+      for(size_t l = LEVELS - 1; l > 0; --l)
+      {
+        if(mNow & ((1ull << (BITS * l)) - 1))
+          continue;
+
+        uint32_t e = TimingWheel::Take(l, (mNow >> (BITS * l)) & (SLOTS - 1));
+        while(e != NONE)
+        {
+          uint32_t next = mEntries[e].mNext;
+          TimingWheel::Place(e);
+          e = next;
+        }
+      }
+
+      uint32_t e = TimingWheel::Take(0, mNow & (SLOTS - 1));
+      while(e != NONE)
+      {
+        emp_assert(mEntries[e].mExpire == mNow);
+        uint32_t next = mEntries[e].mNext;
+        T item = std::move(mEntries[e].mItem);
+        mFree.push_back(e);
+        --mSize;
+        fun(item);
+        e = next;
+      }
+    }
+
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return number of items waiting
+    size_t GetSize() const {return mSize;}
+
+    //Return current tick
+    uint64_t GetNow() const {return mNow;}
+
+  private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Entry
+    {
+      uint64_t mExpire = 0;
+      uint32_t mNext = NONE;
+      T mItem;
+    };
+
+    //Will link entry e into the slot its tick belongs to
+    void Place(uint32_t e)
+    {
+      uint64_t diff = mEntries[e].mExpire ^ mNow;
+      size_t l = 0;
+      while(l < LEVELS - 1 && (diff >> (BITS * (l + 1))))
+        ++l;
+
+      size_t s = (mEntries[e].mExpire >> (BITS * l)) & (SLOTS - 1);
+      mEntries[e].mNext = mHeads[l][s];
+      mHeads[l][s] = e;
+    }
+
+    //Will unlink and return the list of slot s on level l
+    uint32_t Take(size_t l, size_t s)
+    {
+      uint32_t e = mHeads[l][s];
+      mHeads[l][s] = NONE;
+      return e;
+    }
+
+    //Pool of entries
+    std::vector<Entry> mEntries;
+    //Entries free for reuse
+    std::vector<uint32_t> mFree;
+    //First entry of every slot
+    uint32_t mHeads[LEVELS][SLOTS];
+    //Current tick
+    uint64_t mNow;
+    //Number of items waiting
+    size_t mSize;
+};
+
+#endif
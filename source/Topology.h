@@ -0,0 +1,59 @@
+#ifndef HP_TOPOLOGY_H
+#define HP_TOPOLOGY_H
+
+#include <cstddef>
+
+/* TOPOLOGY POLICIES USED TO SPECIALIZE GRAPH AND BROADCAST AT COMPILE TIME */
+
+//Every policy is a grid of dim x dim nodes and provides:
+//  TYPE     => GRA_TYPE value that selects it
+//  DEGREE   => number of neighbors of every node
+//  MIN_DIM  => smallest dim where all neighbors are distinct
+//  ForEachNeighbor(i, j, dim, fun) => calls fun(x, y) on every neighbor until
+//                                     fun returns false, false if it did
+
+//Will wrap a coordinate one step up
+constexpr size_t WrapUp(size_t i, size_t dim) {return (i + 1 == dim) ? 0 : i + 1;}
+
+//Will wrap a coordinate one step down
+constexpr size_t WrapDown(size_t i, size_t dim) {return (i == 0) ? dim - 1 : i - 1;}
+
+//0 => Toroidal Graph (right, left, up, down)
+struct TorusTopology
+{
+  static constexpr size_t TYPE = 0;
+  static constexpr size_t DEGREE = 4;
+  static constexpr size_t MIN_DIM = 3;
+
+  template<typename FUN>
+  static bool ForEachNeighbor(size_t i, size_t j, size_t dim, FUN && fun)
+  {
+    return fun(WrapUp(i, dim), j) && fun(WrapDown(i, dim), j) &&
+           fun(i, WrapUp(j, dim)) && fun(i, WrapDown(j, dim));
+  }
+};
+
+//1 => Toroidal Graph with diagonals (Moore neighborhood)
+struct MooreTopology
+{
+  static constexpr size_t TYPE = 1;
+  static constexpr size_t DEGREE = 8;
+  static constexpr size_t MIN_DIM = 3;
+
+  template<typename FUN>
+  static bool ForEachNeighbor(size_t i, size_t j, size_t dim, FUN && fun)
+  {
+    const size_t up_i = WrapUp(i, dim), down_i = WrapDown(i, dim);
+    const size_t up_j = WrapUp(j, dim), down_j = WrapDown(j, dim);
+
+    return fun(up_i, j) && fun(down_i, j) &&
+           fun(i, up_j) && fun(i, down_j) &&
+           fun(up_i, up_j) && fun(up_i, down_j) &&
+           fun(down_i, up_j) && fun(down_i, down_j);
+  }
+};
+
+//Number of topologies that GRA_TYPE can select
+constexpr size_t NUM_TOPOLOGIES = 2;
+
+#endif
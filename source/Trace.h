@@ -0,0 +1,375 @@
+#ifndef HP_TRACE_H
+#define HP_TRACE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+/* CLASS USED TO RECORD ONE EVALUATION */
+
+//A trace file is "HPT1", [dim][UID per node], then one record per event:
+//  [(zigzag(node - last node) << 3) | kind][value]
+//all numbers LEB128 varints. Nodes are numbered x * dim + y over the grid.
+//  ITER       start of a RunGraph iteration, no node delta, no value
+//  VOTE       zigzag(vote - last whole vote of the node), votes start at -999
+//  VOTE_RAW   vote that is not a whole number, 8 raw bytes
+//  BROADCAST  node sent a BroadcastMail, no value
+//  SPAWN      node spawned cores from mail, value is how many
+//Consecutive events mostly come from nearby nodes and votes move between
+//UIDs, so most records fit in two or three bytes.
+class Trace
+{
+  public:
+    enum Kind : uint8_t {ITER = 0, VOTE, VOTE_RAW, BROADCAST, SPAWN};
+
+    //Vote every node starts with, see Graph::ConfigureTraits
+    static constexpr int64_t START_VOTE = -999;
+
+    /* FUNCTIONS DEDICATED TO RECORDING */
+
+    //Will start over on a dim x dim graph with the given UIDs
+    void Start(size_t dim, const std::vector<size_t> & uids);
+
+    //Will mark the start of an iteration
+    void Iteration() {Trace::Record(ITER, mLast);}
+
+    //Will record node setting its vote
+    void Vote(size_t node, double vote);
+
+    //Will record node broadcasting
+    void Broadcast(size_t node) {Trace::Record(BROADCAST, node);}
+
+    //Will record node spawning cores from mail
+    void Spawn(size_t node, size_t cores)
+    {
+      Trace::Record(SPAWN, node);
+      Trace::PutVarint(cores);
+    }
+
+    //Will write the trace to fname
+    bool Write(const std::string & fname) const;
+
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return bytes of records so far
+    size_t GetSize() const {return mData.size();}
+
+
+    /* FUNCTIONS DEDICATED TO CODING */
+
+    static uint64_t ZigZag(int64_t v) {return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);}
+    static int64_t UnZigZag(uint64_t v) {return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);}
+
+    //Will append v to buf as a varint
+    static void PutVarint(std::vector<uint8_t> & buf, uint64_t v)
+    {
+      while(v >= 0x80)
+      {
+        buf.push_back((uint8_t) v | 0x80);
+        v >>= 7;
+      }
+      buf.push_back((uint8_t) v);
+    }
+
+    //Will read a varint from buf at off, false past the end
+    static bool GetVarint(const std::vector<uint8_t> & buf, size_t & off, uint64_t & v)
+    {
+      v = 0;
+      for(size_t shift = 0; off < buf.size() && shift < 64; shift += 7)
+      {
+        uint8_t b = buf[off++];
+        v |= (uint64_t) (b & 0x7F) << shift;
+        if(!(b & 0x80))
+          return true;
+      }
+      return false;
+    }
+
+  private:
+    //Will append the header of a record
+    void Record(uint8_t kind, size_t node)
+    {
+      Trace::PutVarint(Trace::ZigZag((int64_t) node - (int64_t) mLast) << 3 | kind);
+      mLast = node;
+    }
+
+    void PutVarint(uint64_t v) {Trace::PutVarint(mData, v);}
+
+    //Header and records
+    std::vector<uint8_t> mHead;
+    std::vector<uint8_t> mData;
+    //Node of the last record
+    size_t mLast = 0;
+    //Last whole vote of every node
+    std::vector<int64_t> mVotes;
+};
+
+/* CLASS USED TO REBUILD GRAPH STATE FROM A TRACE */
+class TraceReplay
+{
+  public:
+    /* FUNCTIONS DEDICATED TO REPLAYING */
+
+    //Will load the trace in fname
+    bool Open(const std::string & fname);
+
+    //Will apply the next iteration, false at the end of the trace
+    bool Next();
+
+    //Will print one line per iteration and the final votes
+    static bool Print(const std::string & fname, std::ostream & os = std::cout);
+
+
+    /* FUNCTIONS DEDICATED TO BE GETTERS */
+
+    //Return dimension of the graph
+    size_t GetDim() const {return mDim;}
+
+    //Return iterations applied
+    size_t GetIteration() const {return mIter;}
+
+    //Return vote of node
+    double GetVote(size_t node) const {return mVote[node];}
+
+    //Return broadcasts and spawned cores of node in the last iteration
+    size_t GetBroadcasts(size_t node) const {return mBroadcasts[node];}
+    size_t GetSpawns(size_t node) const {return mSpawns[node];}
+
+    //Return votes set in the last iteration
+    size_t GetVoteChanges() const {return mChanges;}
+
+    //Return if vote is some node's UID
+    bool IsLegal(double vote) const {return mUIDs.count(vote) != 0;}
+
+  private:
+    std::vector<uint8_t> mData;
+    size_t mOff = 0;
+    size_t mDim = 0;
+    size_t mIter = 0;
+    size_t mLast = 0;
+    size_t mChanges = 0;
+    std::unordered_set<double> mUIDs;
+    std::vector<double> mVote;
+    std::vector<int64_t> mWhole;
+    std::vector<size_t> mBroadcasts;
+    std::vector<size_t> mSpawns;
+};
+
+/* FUNCTIONS DEDICATED TO RECORDING */
+
+//Will start over on a dim x dim graph with the given UIDs
+void Trace::Start(size_t dim, const std::vector<size_t> & uids)
+{
+  mHead.clear();
+  mData.clear();
+  mLast = 0;
+  mVotes.assign(dim * dim, (int64_t) START_VOTE);
+
+  mHead.insert(mHead.end(), {'H', 'P', 'T', '1'});
+  Trace::PutVarint(mHead, dim);
+  for(size_t i = 0; i < dim * dim; ++i)
+    Trace::PutVarint(mHead, i < uids.size() ? uids[i] : 0);
+}
+
+//Will record node setting its vote
+void Trace::Vote(size_t node, double vote)
+{
+  if(vote == std::floor(vote) && std::fabs(vote) < 4e18)
+  {
+    int64_t whole = (int64_t) vote;
+    Trace::Record(VOTE, node);
+    Trace::PutVarint(Trace::ZigZag(whole - mVotes[node]));
+    mVotes[node] = whole;
+    return;
+  }
+
+  Trace::Record(VOTE_RAW, node);
+  uint8_t raw[8];
+  std::memcpy(raw, &vote, 8);
+  mData.insert(mData.end(), raw, raw + 8);
+}
+
+//Will write the trace to fname
+bool Trace::Write(const std::string & fname) const
+{
+  std::ofstream out(fname, std::ios::binary | std::ios::trunc);
+
+  if(!out.is_open())
+  {
+    std::cout << "Failed to open trace file(" << fname << ")." << std::endl;
+    return false;
+  }
+
+  out.write((const char *) mHead.data(), mHead.size());
+  out.write((const char *) mData.data(), mData.size());
+  return (bool) out;
+}
+
+/* FUNCTIONS DEDICATED TO REPLAYING */
+
+//Will load the trace in fname
+bool TraceReplay::Open(const std::string & fname)
+{
+  std::ifstream in(fname, std::ios::binary);
+
+  if(!in.is_open())
+  {
+    std::cout << "Failed to open trace file(" << fname << ")." << std::endl;
+    return false;
+  }
+
+  mData.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+  if(mData.size() < 4 || std::memcmp(mData.data(), "HPT1", 4) != 0)
+  {
+    std::cout << fname << " is not a trace file." << std::endl;
+    return false;
+  }
+
+  mOff = 4;
+  uint64_t dim, uid;
+  if(!Trace::GetVarint(mData, mOff, dim))
+    return false;
+
+  mDim = dim;
+  mUIDs.clear();
+  for(size_t i = 0; i < mDim * mDim; ++i)
+  {
+    if(!Trace::GetVarint(mData, mOff, uid))
+      return false;
+    mUIDs.insert(uid);
+  }
+
+  mIter = mLast = mChanges = 0;
+  mVote.assign(mDim * mDim, Trace::START_VOTE);
+  mWhole.assign(mDim * mDim, (int64_t) Trace::START_VOTE);
+  mBroadcasts.assign(mDim * mDim, 0);
+  mSpawns.assign(mDim * mDim, 0);
+  return true;
+}
+
+//Will apply the next iteration, false at the end of the trace
+bool TraceReplay::Next()
+{
+  std::fill(mBroadcasts.begin(), mBroadcasts.end(), 0);
+  std::fill(mSpawns.begin(), mSpawns.end(), 0);
+  mChanges = 0;
+
+  bool started = false;
+
+  while(mOff < mData.size())
+  {
+    size_t at = mOff;
+    uint64_t head, v;
+    if(!Trace::GetVarint(mData, mOff, head))
+      return false;
+
+    uint8_t kind = head & 7;
+    size_t node = mLast + Trace::UnZigZag(head >> 3);
+
+    if(kind == Trace::ITER)
+    {
+      //The next iteration starts here
+      if(started)
+      {
+        mOff = at;
+        break;
+      }
+
+      started = true;
+      ++mIter;
+      continue;
+    }
+
+    if(node >= mVote.size())
+      return false;
+    mLast = node;
+
+    switch(kind)
+    {
+      case Trace::VOTE:
+        if(!Trace::GetVarint(mData, mOff, v))
+          return false;
+        mWhole[node] += Trace::UnZigZag(v);
+        mVote[node] = mWhole[node];
+        ++mChanges;
+        break;
+
+      case Trace::VOTE_RAW:
+        if(mOff + 8 > mData.size())
+          return false;
+        std::memcpy(&mVote[node], &mData[mOff], 8);
+        mOff += 8;
+        ++mChanges;
+        break;
+
+      case Trace::BROADCAST:
+        ++mBroadcasts[node];
+        break;
+
+      case Trace::SPAWN:
+        if(!Trace::GetVarint(mData, mOff, v))
+          return false;
+        mSpawns[node] += v;
+        break;
+
+      default:
+        return false;
+    }
+  }
+
+  return started;
+}
+
+//Will print one line per iteration and the final votes
+//Legal votes are UIDs, largest is the size of the biggest block of equal legal votes
+bool TraceReplay::Print(const std::string & fname, std::ostream & os)
+{
+  TraceReplay replay;
+  if(!replay.Open(fname))
+    return false;
+
+  size_t nodes = replay.GetDim() * replay.GetDim();
+  os << "iter,vote_changes,broadcasts,spawns,legal,largest" << std::endl;
+
+  while(replay.Next())
+  {
+    size_t broadcasts = 0, spawns = 0, legal = 0, largest = 0;
+    std::unordered_map<double, size_t> blocks;
+
+    for(size_t n = 0; n < nodes; ++n)
+    {
+      broadcasts += replay.GetBroadcasts(n);
+      spawns += replay.GetSpawns(n);
+
+      if(replay.IsLegal(replay.GetVote(n)))
+      {
+        ++legal;
+        largest = std::max(largest, ++blocks[replay.GetVote(n)]);
+      }
+    }
+
+    os << replay.GetIteration() << "," << replay.GetVoteChanges() << "," << broadcasts << ","
+       << spawns << "," << legal << "," << largest << std::endl;
+  }
+
+  os << "Final votes:" << std::endl;
+  for(size_t x = 0; x < replay.GetDim(); ++x)
+  {
+    for(size_t y = 0; y < replay.GetDim(); ++y)
+      os << replay.GetVote(x * replay.GetDim() + y) << (y + 1 < replay.GetDim() ? " " : "");
+    os << std::endl;
+  }
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef HP_TRAFFIC_H
+#define HP_TRAFFIC_H
+
+#include <iostream>
+#include <algorithm>
+
+/* STRUCT USED TO COUNT THE MAIL OF ONE NODE OR ONE EVALUATION */
+
+//Counted from the last Graph::Reset(). A broadcast is one BroadcastMail or
+//BroadcastVote dispatch, and sends one copy of its payload per neighbor.
+//Every copy is then delivered into a mailbox, dropped (on an edge, on a
+//down node, past the event budget, or with the mailbox of a node that went
+//down), or is still on an edge when the evaluation ends.
+struct Traffic
+{
+  //Broadcasts dispatched, and the copies they sent
+  size_t mBroadcasts = 0;
+  size_t mSent = 0;
+  //Memory entries carried by the copies sent
+  size_t mPayload = 0;
+  //Copies put into a mailbox, and copies lost
+  size_t mDelivered = 0;
+  size_t mDropped = 0;
+  //Cores spawned from mail or queued events
+  size_t mSpawned = 0;
+  //Most mail waiting in one mailbox at once
+  size_t mInboxPeak = 0;
+
+  //Will clear every counter
+  void Clear() {*this = Traffic();}
+
+  //Will add the counters of other, keeping the higher peak
+  void Add(const Traffic & other)
+  {
+    mBroadcasts += other.mBroadcasts;
+    mSent += other.mSent;
+    mPayload += other.mPayload;
+    mDelivered += other.mDelivered;
+    mDropped += other.mDropped;
+    mSpawned += other.mSpawned;
+    mInboxPeak = std::max(mInboxPeak, other.mInboxPeak);
+  }
+};
+
+/* STRUCT USED TO SUM THE TRAFFIC OF MANY EVALUATIONS */
+struct TrafficReport
+{
+  //Will add the traffic of one finished evaluation
+  void Add(const Traffic & eval)
+  {
+    mTotal.Add(eval);
+    ++mEvals;
+  }
+
+  //Will add the totals of other to this one
+  void MergeReport(const TrafficReport & other)
+  {
+    mTotal.Add(other.mTotal);
+    mEvals += other.mEvals;
+  }
+
+  //Will clear the totals
+  void ClearReport()
+  {
+    mTotal.Clear();
+    mEvals = 0;
+  }
+
+  //Print the mean traffic of an evaluation since the last ClearReport()
+  //Spawned cores are per copy delivered, the peak is over every evaluation
+  void PrintReport(std::ostream & os = std::cout) const
+  {
+    if(mEvals == 0)
+      return;
+
+    os << " MAIL: " << (double) mTotal.mSent / mEvals
+       << " (delivered " << (double) mTotal.mDelivered / mEvals
+       << ", dropped " << (double) mTotal.mDropped / mEvals
+       << ", entries " << (double) mTotal.mPayload / mEvals
+       << ", spawns/mail " << (mTotal.mDelivered ? (double) mTotal.mSpawned / mTotal.mDelivered : 0.0)
+       << ", peak " << mTotal.mInboxPeak << ")";
+  }
+
+  //Traffic summed over the evaluations
+  Traffic mTotal;
+  size_t mEvals = 0;
+};
+
+#endif
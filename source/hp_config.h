@@ -13,20 +13,49 @@ EMP_BUILD_CONFIG( HPConfig,
   VALUE(POSX,      size_t,  2, "Position that the Coordinate X will be in hw trait vector"),
   VALUE(POSY,      size_t,  3, "Position that the Coordinate Y will be in hw trait vector"),
   VALUE(MAX_CORES, size_t,  20, "Maximum number of cores a hardware can spawn."),
+  GROUP(BUDGET_GROUP, "Per evaluation budgets (0 = no limit)"),
+  VALUE(NODE_INST_BUDGET,  size_t,       0, "Maximum instructions one node may execute per evaluation."),
+  VALUE(NODE_CORE_BUDGET,  size_t,       0, "Maximum cores one node may spawn from events per evaluation."),
+  VALUE(NODE_EVENT_BUDGET, size_t,       0, "Maximum events that may be queued on one node per evaluation."),
+  VALUE(EVAL_INST_BUDGET,  size_t,       0, "Maximum instructions the whole graph may execute per evaluation."),
+  VALUE(EVAL_CORE_BUDGET,  size_t, 1000000, "Maximum cores the whole graph may spawn from events per evaluation."),
+  VALUE(EVAL_EVENT_BUDGET, size_t, 1000000, "Maximum events that may be queued in the whole graph per evaluation."),
+  VALUE(OVERRUN_SCORE,     double,    -1.0, "Score given to an evaluation that passes a budget."),
+  VALUE(ALLOC_BUDGET,      size_t,       0, "Maximum heap allocations per agent evaluated, averaged over a generation, before Run fails (needs make alloc-stats)."),
   GROUP(GRAPH_GROUP, "Graph settings"),
   VALUE(GRA_DIM,  size_t,       3, "Dimension of graph"),
   VALUE(NUM_ITER, size_t,     128, "Number of iterations per trial."),
   VALUE(NUM_FRI,  size_t,       3, "Number of friends in the graph."),
   VALUE(NUM_ENE,  size_t,       1, "Number of enemies in the graph."),
   VALUE(GRA_TYPE, size_t,       0, "Type of graph we are about to use."),
+  VALUE(NODE_ORDER, size_t,     0, "Memory order of the nodes: 0 = row major, 1 = BFS, 2 = reverse Cuthill-McKee (both follow the edges), 3 = Hilbert curve (suits the grid). Results are the same in any order."),
   VALUE(MIN_BND,  size_t,       1, "Lower bound on random numbers."),
   VALUE(MAX_BND,  size_t, 1000000, "Uper bound on the random numbers."),
+  GROUP(NETWORK_GROUP, "Message delivery settings (all 0 = instant and reliable)"),
+  VALUE(LATENCY_MIN,    size_t,   0, "Least iterations a broadcast spends on an edge."),
+  VALUE(LATENCY_MAX,    size_t,   0, "Most iterations a broadcast spends on an edge, every edge draws its own in [LATENCY_MIN, LATENCY_MAX]."),
+  VALUE(LATENCY_JITTER, size_t,   0, "Extra iterations, drawn in [0, LATENCY_JITTER], added to every broadcast."),
+  VALUE(DROP_RATE,      double, 0.0, "Mean chance a broadcast is lost, every edge draws its own in [0, 2 * DROP_RATE]."),
+  GROUP(CHURN_GROUP, "Topology churn settings (all 0 = frozen graph)"),
+  VALUE(CHURN_START,   size_t,   0, "Iteration churn starts at."),
+  VALUE(CHURN_FAIL,    double, 0.0, "Chance per iteration that a live node goes down, dropping its mail."),
+  VALUE(CHURN_RECOVER, double, 0.0, "Chance per iteration that a down node comes back, with fresh hardware and no vote."),
+  VALUE(CHURN_REWIRE,  double, 0.0, "Chance per iteration that a live node moves one of its edges to a random live node."),
   GROUP(MUTATION_GROUP, "Mutation settings"),
   VALUE(MIN_FUN_CNT, size_t,   1, "Minimum number of functions each hardware should have."),
   VALUE(MAX_FUN_CNT, size_t,  8, "Maximum number of functions each hardware should have."),
   VALUE(MIN_FUN_LEN, size_t,   5, "Minimum number of instructions each function will have."),
   VALUE(MAX_FUN_LEN, size_t,  64, "Maximum number of instructions each function will have."),
   VALUE(MAX_TOT_LEN,  size_t, 512, "Maximum size of hardware genome."),
+  VALUE(MAX_ARG_VAL,  size_t,  16, "Instruction arguments are drawn from [0, MAX_ARG_VAL), at most 32."),
+  VALUE(MUT_FUNC_DUP, double, 0.05, "Per function rate of being duplicated."),
+  VALUE(MUT_FUNC_DEL, double, 0.05, "Per function rate of being deleted."),
+  VALUE(MUT_SLIP,     double, 0.05, "Per function rate of a slip, duplicating or deleting a random stretch."),
+  VALUE(MUT_INST_INS, double, 0.005, "Per instruction rate of a random instruction being inserted."),
+  VALUE(MUT_INST_DEL, double, 0.005, "Per instruction rate of being deleted."),
+  VALUE(MUT_INST_SUB, double, 0.005, "Per instruction rate of being substituted."),
+  VALUE(MUT_ARG_SUB,  double, 0.005, "Per argument rate of being substituted."),
+  VALUE(MUT_TAG_FLIP, double, 0.005, "Per tag bit rate of being flipped."),
   VALUE(MIN_BIN_THSH, size_t, 0.0, "Minimum Threshold for "),
   GROUP(EXPERIMENT_GROUP, "Experiment settings"),
   VALUE(POP_SIZE,  size_t, 20000, "Population size."),
@@ -34,7 +63,38 @@ EMP_BUILD_CONFIG( HPConfig,
   VALUE(RNG_SEED,  size_t,    80, "Random number seed."),
   VALUE(EVAL_SIZE, size_t,     5, "Number of bad guys a good guy will face per run."),
   VALUE(TOURN_SIZE, size_t,    2, "Number or organims competing in tournament selection."),
-  VALUE(SNAP_SHOT,  size_t,   50, "Time that we will take a snapshot of population")
+  VALUE(REPRO_THREADS, size_t,  0, "Threads that select and mutate the next generation (0 = one per core, or 1 in a sweep row)."),
+  VALUE(SNAP_SHOT,  size_t,   50, "Time that we will take a snapshot of population"),
+  VALUE(SKIP_INERT, bool,   true, "Will score genomes that can never vote or broadcast 0 without running them."),
+  VALUE(TRAFFIC_COST, double, 0.0, "Score lost per mail copy sent per node in an evaluation (0 = mail is free)."),
+  GROUP(ADVERSARY_GROUP, "Adversarial co-evaluation settings"),
+  VALUE(ADVERSARIAL,  bool,   false, "Will run NUM_ENE nodes of every graph on genomes from a co-evolving enemy population."),
+  VALUE(ENE_POP_SIZE, size_t,   100, "Enemy population size."),
+  VALUE(EVAL_THREADS, size_t,     1, "Threads, each with its own graph, that evaluate good vs bad pairings."),
+  GROUP(SCREEN_GROUP, "Screening settings (SCREEN_DIM 0 = every agent gets the full graph)"),
+  VALUE(SCREEN_DIM,  size_t,      0, "Dimension of the small graph every agent is screened on."),
+  VALUE(SCREEN_ITER, size_t,     16, "Number of iterations of a screening run."),
+  VALUE(SCREEN_FRAC, double,   0.25, "Fraction of the population, best screened first, promoted to the full graph."),
+  GROUP(ARCHIVE_GROUP, "Elite archive settings"),
+  VALUE(ARCHIVE_FILE,  std::string, "archive", "Base name of the elite archive (.hpa data, .hpi index)."),
+  VALUE(ARCHIVE_TOP,   size_t,            10, "Number of best agents archived every SNAP_SHOT generations."),
+  VALUE(ARCHIVE_QUEUE, size_t,             4, "Snapshots that may wait for the archive writer before Run blocks."),
+  VALUE(LINEAGE_FILE,  std::string, "lineage.csv", "Where the ancestry of the final best agent is written."),
+  VALUE(STATUS_FILE,   std::string,            "", "Mapped file live run metrics are written to every generation (empty = none, read with main --status <file>)."),
+  VALUE(TRACE_FILE,    std::string,            "", "Base name of the trace of the best agent of every snapshot, <name>_<gen>.hpt (empty = no traces, replay with main --replay <file>)."),
+  GROUP(FARM_GROUP, "Worker process settings (FARM_PROCS 0 = evaluate in this process)"),
+  VALUE(FARM_PROCS,   size_t,     0, "Forked processes agents are evaluated in."),
+  VALUE(FARM_BATCH,   size_t,    16, "Agents sent to a worker at once."),
+  VALUE(FARM_TIMEOUT, size_t, 10000, "Milliseconds a worker may go without answering before it is restarted (0 = no limit)."),
+  VALUE(FARM_RETRIES, size_t,     2, "Worker failures an agent may cause before it gets OVERRUN_SCORE."),
+  GROUP(BATCH_GROUP, "Batch scoring settings (main --evaluate <genome file or archive@gen> ...)"),
+  VALUE(BATCH_TRIALS, size_t,  32, "UID trials every genome is run for on every graph."),
+  VALUE(BATCH_DIMS,   std::string, "", "Comma separated GRA_DIM values to score on (empty = GRA_DIM)."),
+  VALUE(BATCH_TYPES,  std::string, "", "Comma separated GRA_TYPE values to score on (empty = GRA_TYPE)."),
+  VALUE(BATCH_ORDERS, std::string, "", "Comma separated NODE_ORDER values to score on (empty = NODE_ORDER), to compare node layouts."),
+  GROUP(SHARD_GROUP, "Sharded evaluation settings (main --shard <gen>)"),
+  VALUE(SHARD_PROCS,    size_t,    4, "Processes the rows of one graph are split across."),
+  VALUE(SHARD_MAIL_CAP, size_t, 8192, "Broadcasts a band may send to each neighboring band per iteration, the rest are dropped.")
 )
 
 #endif
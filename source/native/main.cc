@@ -1,18 +1,72 @@
 // This is t./he main function for the NATIVE version of this project.
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
 
 #include "config/command_line.h"
 #include "config/ArgManager.h"
 
 #include "../Experiment.h"
+#include "../Sweep.h"
+#include "../Shard.h"
+#include "../Trace.h"
+#include "../Batch.h"
+#include "../Status.h"
+#include "../Parse.h"
 #include "../hp_config.h"
 
 int main(int argc, char* argv[])
 {
 	// Read configs.
 	std::string config_fname = "configs.cfg";
-	auto args = emp::cl::ArgManager(argc, argv);
+
+	// Pull out the sweep options before the config options are read.
+	std::string sweep_fname;
+	std::string dump_gen;
+	std::string shard_gen;
+	std::string replay_fname;
+	std::string status_fname;
+	std::vector<std::string> evaluate_specs;
+	size_t threads = std::thread::hardware_concurrency();
+	std::vector<char *> config_argv;
+	for (int i = 0; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--sweep" && i + 1 < argc)
+			sweep_fname = argv[++i];
+		else if (arg == "--threads" && i + 1 < argc)
+		{
+			if (!ReadNumber(argv[++i], threads))
+			{
+				std::cout << "--threads takes a number, not " << argv[i] << "." << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--dump" && i + 1 < argc)
+			dump_gen = argv[++i];
+		else if (arg == "--shard" && i + 1 < argc)
+			shard_gen = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc)
+			replay_fname = argv[++i];
+		else if (arg == "--status" && i + 1 < argc)
+			status_fname = argv[++i];
+		else if (arg == "--evaluate" && i + 1 < argc)
+			evaluate_specs.push_back(argv[++i]);
+		else
+			config_argv.push_back(argv[i]);
+	}
+
+	// Replaying a trace needs no config.
+	if (!replay_fname.empty())
+		return TraceReplay::Print(replay_fname, std::cout) ? 0 : -1;
+
+	// Reading the metrics of a running experiment needs no config either.
+	if (!status_fname.empty())
+		return Status::Print(status_fname, std::cout) ? 0 : -1;
+
+	auto args = emp::cl::ArgManager(config_argv.size(), config_argv.data());
 	HPConfig config;
 	config.Read(config_fname);
 
@@ -28,9 +82,53 @@ int main(int argc, char* argv[])
 	std::cout << "==============================\n"
 	    << std::endl;
 
+	// Sweep rows are checked again by Sweep::Run.
+	if (!Experiment::CheckConfig(config, std::cout))
+		exit(-1);
+
+	// Every row of the sweep matrix starts from configs.cfg.
+	if (!sweep_fname.empty())
+	{
+		Sweep sweep(config_fname, sweep_fname, threads);
+		return sweep.Run(std::cout) ? 0 : -1;
+	}
+
+	// Evaluate one archived agent on a graph split across processes.
+	if (!shard_gen.empty())
+	{
+		size_t gen;
+		if (!ReadNumber(shard_gen, gen))
+		{
+			std::cout << "--shard takes a generation number, not " << shard_gen << "." << std::endl;
+			return -1;
+		}
+
+		Shard shard(config);
+		return shard.EvaluateArchive(gen, std::cout) ? 0 : -1;
+	}
+
+	// Score fixed genomes over BATCH_TRIALS, BATCH_DIMS, BATCH_TYPES and BATCH_ORDERS.
+	if (!evaluate_specs.empty())
+	{
+		Batch batch(config, threads);
+		if (!batch.Load(evaluate_specs))
+			return -1;
+		return batch.Run(std::cout) ? 0 : -1;
+	}
+
+	// Checked before the experiment is built.
+	size_t dump = 0;
+	if (!dump_gen.empty() && !ReadNumber(dump_gen, dump))
+	{
+		std::cout << "--dump takes a generation number, not " << dump_gen << "." << std::endl;
+		return -1;
+	}
 
     Experiment e(config);
-	e.Run();
 
-	return 0;
+	// Print the archived elites of one generation instead of running.
+	if (!dump_gen.empty())
+		return e.PrintArchive(dump, std::cout) ? 0 : -1;
+
+	return e.Run() ? 0 : -1;
 }